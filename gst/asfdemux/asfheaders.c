@@ -37,6 +37,21 @@ const ASFGuidHash asf_payload_ext_guids[] = {
       }
 };
 
+const ASFGuidHash asf_mutex_guids[] = {
+  {ASF_MUTEX_LANGUAGE, "ASF_MUTEX_LANGUAGE",
+        {0xd6e22a00, 0x11d135da, 0xa0003490, 0xbe4903c9}
+      },
+  {ASF_MUTEX_BITRATE, "ASF_MUTEX_BITRATE",
+        {0xd6e22a01, 0x11d135da, 0xa0003490, 0xbe4903c9}
+      },
+  {ASF_MUTEX_UNKNOWN, "ASF_MUTEX_UNKNOWN",
+        {0xd6e22a02, 0x11d135da, 0xa0003490, 0xbe4903c9}
+      },
+  {ASF_MUTEX_UNDEFINED, "ASF_MUTEX_UNDEFINED",
+        {0, 0, 0, 0}
+      }
+};
+
 const ASFGuidHash asf_correction_guids[] = {
   {ASF_CORRECTION_ON, "ASF_CORRECTION_ON",
         {0xBFC3CD50, 0x11CF618F, 0xAA00B28B, 0x20E2B400}
@@ -98,8 +98,17 @@ typedef enum {
   ASF_PAYLOAD_EXTENSION_TIMING
 } AsfPayloadExtensionID;
 
+typedef enum {
+  ASF_MUTEX_UNDEFINED = 0,
+  ASF_MUTEX_LANGUAGE,
+  ASF_MUTEX_BITRATE,
+  ASF_MUTEX_UNKNOWN
+} AsfMutexType;
+
 extern const ASFGuidHash asf_payload_ext_guids[];
 
+extern const ASFGuidHash asf_mutex_guids[];
+
 extern const ASFGuidHash asf_correction_guids[];
 
 extern const ASFGuidHash asf_stream_guids[];
@@ -0,0 +1,348 @@
+/* GStreamer ASF/WMV/WMA demuxer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Helpers for the per-stream indexes from the index object, and for the
+ * index learned while playing files without any index.
+ *
+ * Entries of the learned index map the timestamp of a keyframe (or any media
+ * object for audio-only files) to the packet it starts in, at most one per
+ * ASF_LEARNED_INDEX_INTERVAL. An entry is only used for seeking if playback
+ * ran from it to the next entry, otherwise there might be keyframes in
+ * between we don't know about.
+ *
+ * Keyframes less than ASF_LEARNED_INDEX_INTERVAL after an entry are not
+ * recorded, which keeps the index small for streams where every frame is a
+ * keyframe. That interval is the granularity of seeks with the learned index:
+ * a seek may start up to that much before the keyframe a full index would
+ * give, and a seek to the next keyframe may skip the ones not recorded.
+ *
+ * The index can be stored in a cache file, which looks like this (all values
+ * little endian):
+ *
+ *   "GstAsfIx"   magic
+ *   guint32      version (1)
+ *   guint32      packet size
+ *   guint64      number of packets
+ *   guint16      number of the stream the index was learned from
+ *   guint16      reserved
+ *   guint32      number of entries
+ *
+ * followed by the entries:
+ *
+ *   guint64      timestamp
+ *   guint32      packet
+ *   guint32      flags (0x1: contiguous)
+ */
+
+#include "asfindex.h"
+#include "gstasfdemux.h"
+
+#include <gst/base/gstbytereader.h>
+#include <gst/base/gstbytewriter.h>
+#include <string.h>
+
+#define ASF_LEARNED_INDEX_MAGIC        "GstAsfIx"
+#define ASF_LEARNED_INDEX_VERSION      1
+#define ASF_LEARNED_INDEX_HEADER_SIZE  (8 + 4 + 4 + 8 + 2 + 2 + 4)
+#define ASF_LEARNED_INDEX_ENTRY_SIZE   (8 + 4 + 4)
+
+#define ASF_LEARNED_INDEX_FLAG_CONTIGUOUS  (1 << 0)
+
+/* returns the position of the last entry with a timestamp not bigger than
+ * @ts, or -1 if there is none */
+gint
+asf_index_find_entry (const AsfIndexEntry * entries, guint num_entries,
+    GstClockTime ts)
+{
+  guint lo = 0, hi = num_entries;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (entries[mid].ts <= ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return (gint) lo - 1;
+}
+
+/* returns the position of the first entry with a timestamp bigger than @ts */
+static guint
+asf_learned_index_upper_bound (GArray * index, GstClockTime ts)
+{
+  guint lo = 0, hi = index->len;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (g_array_index (index, AsfLearnedIndexEntry, mid).ts <= ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* records that a media object with timestamp @ts starts in @packet. @p_last
+ * holds the position of the entry seen last while playing without
+ * discontinuities, or -1. Returns TRUE if the index changed. */
+gboolean
+asf_learned_index_add (GArray * index, gint * p_last, GstClockTime ts,
+    guint32 packet)
+{
+  AsfLearnedIndexEntry entry;
+  gint prev;
+
+  g_return_val_if_fail (GST_CLOCK_TIME_IS_VALID (ts), FALSE);
+
+  prev = (gint) asf_learned_index_upper_bound (index, ts) - 1;
+
+  if (prev >= 0) {
+    AsfLearnedIndexEntry *e;
+
+    e = &g_array_index (index, AsfLearnedIndexEntry, prev);
+    if (e->packet == packet || ts < e->ts + ASF_LEARNED_INDEX_INTERVAL) {
+      gboolean changed = FALSE;
+
+      /* close enough to an existing entry, so not recorded even if it is a
+       * keyframe of its own; if we came here from the entry before, we now
+       * know there's nothing else in between them */
+      if (*p_last >= 0 && *p_last == prev - 1 && !e->contiguous) {
+        e->contiguous = TRUE;
+        changed = TRUE;
+      }
+      *p_last = prev;
+      return changed;
+    }
+  }
+
+  entry.ts = ts;
+  entry.packet = packet;
+  entry.contiguous = (*p_last >= 0 && *p_last == prev);
+
+  g_array_insert_val (index, prev + 1, entry);
+  *p_last = prev + 1;
+
+  return TRUE;
+}
+
+/* finds the packet of the entry at or before @ts, or the one after it if
+ * @next is set; keyframes that weren't recorded are passed over */
+gboolean
+asf_learned_index_lookup (GArray * index, GstClockTime ts, gboolean next,
+    guint32 * packet, GstClockTime * entry_ts)
+{
+  AsfLearnedIndexEntry *e;
+  guint pos;
+
+  pos = asf_learned_index_upper_bound (index, ts);
+
+  if (pos == 0 || pos >= index->len)
+    return FALSE;
+
+  /* we only know there is no other keyframe between the entries if we
+   * played from one to the other */
+  e = &g_array_index (index, AsfLearnedIndexEntry, pos);
+  if (!e->contiguous)
+    return FALSE;
+
+  if (!next)
+    e = &g_array_index (index, AsfLearnedIndexEntry, pos - 1);
+
+  *packet = e->packet;
+  if (entry_ts)
+    *entry_ts = e->ts;
+
+  return TRUE;
+}
+
+/* estimates the packet a media object at @ts starts in, by interpolating
+ * between the entries around it, or the start (@start_ts, packet 0) and end
+ * (@end_ts, @num_packets) of the data. Good enough for push mode seeks,
+ * which don't need to start on a keyframe. */
+guint32
+asf_learned_index_estimate (GArray * index, GstClockTime ts,
+    GstClockTime start_ts, GstClockTime end_ts, guint64 num_packets)
+{
+  AsfLearnedIndexEntry *e;
+  GstClockTime ts0 = start_ts, ts1 = end_ts;
+  guint64 packet0 = 0, packet1 = num_packets;
+  guint pos;
+
+  pos = asf_learned_index_upper_bound (index, ts);
+
+  if (pos > 0) {
+    e = &g_array_index (index, AsfLearnedIndexEntry, pos - 1);
+    ts0 = e->ts;
+    packet0 = e->packet;
+  }
+  if (pos < index->len) {
+    e = &g_array_index (index, AsfLearnedIndexEntry, pos);
+    ts1 = e->ts;
+    packet1 = e->packet;
+  }
+
+  if (ts <= ts0 || ts1 <= ts0 || packet1 <= packet0)
+    return (guint32) packet0;
+
+  return (guint32) (packet0 + gst_util_uint64_scale (packet1 - packet0,
+          MIN (ts, ts1) - ts0, ts1 - ts0));
+}
+
+gboolean
+asf_learned_index_load (GArray * index, guint16 * stream_num,
+    const gchar * filename, guint64 num_packets, guint32 packet_size)
+{
+  GstByteReader reader;
+  GError *err = NULL;
+  const guint8 *magic;
+  GstClockTime last_ts = 0;
+  guint32 version, file_packet_size, count, i;
+  guint64 file_num_packets;
+  guint16 file_stream_num, reserved;
+  gchar *contents;
+  gsize len;
+
+  if (!g_file_get_contents (filename, &contents, &len, &err)) {
+    GST_DEBUG ("no index cache %s: %s", filename, err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+
+  gst_byte_reader_init (&reader, (const guint8 *) contents, len);
+
+  if (!gst_byte_reader_get_data (&reader, 8, &magic) ||
+      memcmp (magic, ASF_LEARNED_INDEX_MAGIC, 8) != 0)
+    goto invalid;
+
+  if (!gst_byte_reader_get_uint32_le (&reader, &version) ||
+      !gst_byte_reader_get_uint32_le (&reader, &file_packet_size) ||
+      !gst_byte_reader_get_uint64_le (&reader, &file_num_packets) ||
+      !gst_byte_reader_get_uint16_le (&reader, &file_stream_num) ||
+      !gst_byte_reader_get_uint16_le (&reader, &reserved) ||
+      !gst_byte_reader_get_uint32_le (&reader, &count))
+    goto invalid;
+
+  if (version != ASF_LEARNED_INDEX_VERSION)
+    goto invalid;
+
+  /* make sure the cache was made for this very file */
+  if (file_packet_size != packet_size || file_num_packets != num_packets ||
+      file_stream_num == 0 || file_stream_num > GST_ASF_DEMUX_NUM_STREAM_IDS)
+    goto invalid;
+
+  if (gst_byte_reader_get_remaining (&reader) !=
+      (guint64) count * ASF_LEARNED_INDEX_ENTRY_SIZE)
+    goto invalid;
+
+  g_array_set_size (index, 0);
+
+  for (i = 0; i < count; ++i) {
+    AsfLearnedIndexEntry entry;
+    guint32 flags;
+
+    entry.ts = gst_byte_reader_get_uint64_le_unchecked (&reader);
+    entry.packet = gst_byte_reader_get_uint32_le_unchecked (&reader);
+    flags = gst_byte_reader_get_uint32_le_unchecked (&reader);
+    entry.contiguous = (flags & ASF_LEARNED_INDEX_FLAG_CONTIGUOUS) != 0;
+
+    if (!GST_CLOCK_TIME_IS_VALID (entry.ts) || entry.packet >= num_packets ||
+        (i > 0 && entry.ts <= last_ts)) {
+      g_array_set_size (index, 0);
+      goto invalid;
+    }
+    last_ts = entry.ts;
+
+    g_array_append_val (index, entry);
+  }
+
+  g_free (contents);
+
+  *stream_num = file_stream_num;
+
+  GST_DEBUG ("loaded %u index entries for stream %u from %s", count,
+      file_stream_num, filename);
+
+  return TRUE;
+
+invalid:
+  {
+    GST_WARNING ("ignoring invalid index cache %s", filename);
+    g_free (contents);
+    return FALSE;
+  }
+}
+
+gboolean
+asf_learned_index_save (GArray * index, guint16 stream_num,
+    const gchar * filename, guint64 num_packets, guint32 packet_size)
+{
+  GstByteWriter writer;
+  GError *err = NULL;
+  gchar *dirname;
+  guint size, i;
+  guint8 *data;
+  gboolean ret;
+
+  gst_byte_writer_init_with_size (&writer, ASF_LEARNED_INDEX_HEADER_SIZE +
+      index->len * ASF_LEARNED_INDEX_ENTRY_SIZE, FALSE);
+
+  gst_byte_writer_put_data (&writer, (const guint8 *) ASF_LEARNED_INDEX_MAGIC,
+      8);
+  gst_byte_writer_put_uint32_le (&writer, ASF_LEARNED_INDEX_VERSION);
+  gst_byte_writer_put_uint32_le (&writer, packet_size);
+  gst_byte_writer_put_uint64_le (&writer, num_packets);
+  gst_byte_writer_put_uint16_le (&writer, stream_num);
+  gst_byte_writer_put_uint16_le (&writer, 0);
+  gst_byte_writer_put_uint32_le (&writer, index->len);
+
+  for (i = 0; i < index->len; ++i) {
+    AsfLearnedIndexEntry *e;
+
+    e = &g_array_index (index, AsfLearnedIndexEntry, i);
+    gst_byte_writer_put_uint64_le (&writer, e->ts);
+    gst_byte_writer_put_uint32_le (&writer, e->packet);
+    gst_byte_writer_put_uint32_le (&writer,
+        e->contiguous ? ASF_LEARNED_INDEX_FLAG_CONTIGUOUS : 0);
+  }
+
+  size = gst_byte_writer_get_size (&writer);
+  data = gst_byte_writer_reset_and_get_data (&writer);
+
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, 0755);
+  g_free (dirname);
+
+  /* written to a temporary file and renamed, so readers never see a
+   * partial cache */
+  ret = g_file_set_contents (filename, (const gchar *) data, size, &err);
+  if (!ret) {
+    GST_WARNING ("could not write index cache %s: %s", filename, err->message);
+    g_error_free (err);
+  } else {
+    GST_DEBUG ("saved %u index entries for stream %u to %s", index->len,
+        stream_num, filename);
+  }
+
+  g_free (data);
+
+  return ret;
+}
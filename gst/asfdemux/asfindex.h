@@ -0,0 +1,68 @@
+/* GStreamer ASF/WMV/WMA demuxer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __ASF_INDEX_H__
+#define __ASF_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct {
+  GstClockTime  ts;          /* presentation time, including preroll       */
+  guint32       packet;      /* packet to start reading from               */
+} AsfIndexEntry;
+
+gint      asf_index_find_entry     (const AsfIndexEntry * entries,
+                                    guint num_entries, GstClockTime ts);
+
+/* minimum distance between two entries of the learned index, and so the
+ * granularity of seeks with it */
+#define ASF_LEARNED_INDEX_INTERVAL  GST_SECOND
+
+typedef struct {
+  GstClockTime  ts;          /* media object time minus preroll            */
+  guint32       packet;      /* packet the media object starts in          */
+  gboolean      contiguous;  /* playback ran from the previous entry to this
+                              * one, so any keyframe in between is less than
+                              * the interval after the previous entry      */
+} AsfLearnedIndexEntry;
+
+gboolean  asf_learned_index_add    (GArray * index, gint * p_last,
+                                    GstClockTime ts, guint32 packet);
+
+gboolean  asf_learned_index_lookup (GArray * index, GstClockTime ts,
+                                    gboolean next, guint32 * packet,
+                                    GstClockTime * entry_ts);
+
+guint32   asf_learned_index_estimate (GArray * index, GstClockTime ts,
+                                      GstClockTime start_ts,
+                                      GstClockTime end_ts,
+                                      guint64 num_packets);
+
+gboolean  asf_learned_index_load   (GArray * index, guint16 * stream_num,
+                                    const gchar * filename,
+                                    guint64 num_packets, guint32 packet_size);
+
+gboolean  asf_learned_index_save   (GArray * index, guint16 stream_num,
+                                    const gchar * filename,
+                                    guint64 num_packets, guint32 packet_size);
+
+G_END_DECLS
+
+#endif /* __ASF_INDEX_H__ */
@@ -90,20 +90,107 @@ asf_packet_create_payload_buffer (AsfPacket * packet, const guint8 ** p_data,
       payload_len);
 }
 
-static AsfPayload *
-asf_payload_search_payloads_queue (AsfPayload * payload, GArray * payload_list)
+/* appends the payload data as a memory share of the packet to the buffer of
+ * a fragmented media object, so we don't have to copy the fragments around */
+static void
+asf_packet_append_payload_memory (AsfPacket * packet, GstBuffer * buf,
+    const guint8 * payload_data, guint payload_len)
 {
-  AsfPayload *ret = NULL;
-  gint idx;
-  for (idx = payload_list->len - 1; idx >= 0; idx--) {
-    ret = &g_array_index (payload_list, AsfPayload, idx);
+  guint off;
 
-    if (G_UNLIKELY (ret->mo_size == payload->mo_size &&
-            ret->mo_number == payload->mo_number)) {
-      return ret;
-    }
+  off = (guint) (payload_data - packet->bdata);
+  g_assert (off + payload_len <= gst_buffer_get_size (packet->buf));
+
+  gst_buffer_copy_into (buf, packet->buf, GST_BUFFER_COPY_MEMORY, off,
+      payload_len);
+}
+
+/* whether a media object of @mo_size bytes can be assembled from memory
+ * shares of fragments of @payload_len bytes. A buffer holds only so many
+ * memories and merges them into a new one on every append beyond that, so
+ * for many small fragments copying them into one buffer right away is
+ * cheaper. */
+static inline gboolean
+asf_payload_fragments_fit (guint32 mo_size, guint payload_len)
+{
+  guint64 num_fragments;
+
+  num_fragments = ((guint64) mo_size + payload_len - 1) / payload_len;
+  return num_fragments <= gst_buffer_get_max_memory ();
+}
+
+/* media objects are assembled from memory shares of the packets for as long
+ * as the fragments come in order and fit into the buffer; if they don't, fall
+ * back to a buffer of the full media object size that the fragments are
+ * copied into */
+static void
+asf_payload_ensure_full_size (GstASFDemux * demux, AsfStream * stream,
+    AsfPayload * payload)
+{
+  GstBuffer *buf;
+  gsize size;
+
+  size = gst_buffer_get_size (payload->buf);
+  if (size >= payload->mo_size)
+    return;
+
+  GST_LOG ("fragments out of order or too small, allocating buffer of size "
+      "%u for media object", payload->mo_size);
+
+  buf = gst_asf_demux_alloc_buffer (demux, stream, payload->mo_size);
+  gst_buffer_copy_into (buf, payload->buf, GST_BUFFER_COPY_METADATA, 0, -1);
+  if (size > 0) {
+    GstMapInfo map;
+
+    gst_buffer_map (payload->buf, &map, GST_MAP_READ);
+    gst_buffer_fill (buf, 0, map.data, map.size);
+    gst_buffer_unmap (payload->buf, &map);
   }
-  return NULL;
+
+  gst_buffer_unref (payload->buf);
+  payload->buf = buf;
+}
+
+static void
+asf_payload_index_insert (GHashTable * payload_idx, AsfPayload * payload,
+    guint pos)
+{
+  guint64 *key;
+
+  key = g_new (guint64, 1);
+  *key = ((guint64) payload->mo_number << 32) | payload->mo_size;
+
+  /* later payloads replace earlier ones with the same key, which is what a
+   * backwards search of the queue would have found */
+  g_hash_table_replace (payload_idx, key, GUINT_TO_POINTER (pos + 1));
+}
+
+static void
+asf_payload_index_rebuild (AsfStream * stream)
+{
+  guint i;
+
+  g_hash_table_remove_all (stream->payloads_idx);
+  for (i = 0; i < stream->payloads->len; ++i) {
+    asf_payload_index_insert (stream->payloads_idx,
+        &g_array_index (stream->payloads, AsfPayload, i), i);
+  }
+  stream->payloads_idx_valid = TRUE;
+}
+
+static AsfPayload *
+asf_payload_search_payloads_queue (AsfPayload * payload, GArray * payload_list,
+    GHashTable * payload_idx)
+{
+  guint64 key;
+  guint pos;
+
+  key = ((guint64) payload->mo_number << 32) | payload->mo_size;
+  pos = GPOINTER_TO_UINT (g_hash_table_lookup (payload_idx, &key));
+  if (pos == 0 || pos > payload_list->len)
+    return NULL;
+
+  return &g_array_index (payload_list, AsfPayload, pos - 1);
 }
 
 static AsfPayload *
@@ -114,8 +201,12 @@ asf_payload_find_previous_fragment (GstASFDemux * demux, AsfPayload * payload,
 
   if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
 
+    if (!stream->payloads_idx_valid)
+      asf_payload_index_rebuild (stream);
+
     /* Search in queued payloads list */
-    ret = asf_payload_search_payloads_queue (payload, stream->payloads);
+    ret = asf_payload_search_payloads_queue (payload, stream->payloads,
+        stream->payloads_idx);
     if (ret) {
       GST_DEBUG
           ("previous fragments found in payloads queue for reverse playback : object ID %d",
@@ -124,7 +215,8 @@ asf_payload_find_previous_fragment (GstASFDemux * demux, AsfPayload * payload,
     }
 
     /* Search in payloads 'to be queued' list */
-    ret = asf_payload_search_payloads_queue (payload, stream->payloads_rev);
+    ret = asf_payload_search_payloads_queue (payload, stream->payloads_rev,
+        stream->payloads_rev_idx);
     if (ret) {
       GST_DEBUG
           ("previous fragments found in temp payload queue for reverse playback : object ID %d",
@@ -234,6 +326,7 @@ gst_asf_payload_queue_for_stream_forward (GstASFDemux * demux,
   }
 
   g_array_append_vals (stream->payloads, payload, 1);
+  stream->payloads_idx_valid = FALSE;
 }
 
 static void
@@ -246,9 +339,14 @@ gst_asf_payload_queue_for_stream_reverse (GstASFDemux * demux,
   if (demux->multiple_payloads) {
     /* store the payload in temporary buffer, until we parse all payloads in this packet */
     g_array_append_vals (stream->payloads_rev, payload, 1);
+    asf_payload_index_insert (stream->payloads_rev_idx, payload,
+        stream->payloads_rev->len - 1);
   } else {
     if (G_LIKELY (GST_CLOCK_TIME_IS_VALID (payload->ts))) {
       g_array_append_vals (stream->payloads, payload, 1);
+      if (stream->payloads_idx_valid)
+        asf_payload_index_insert (stream->payloads_idx, payload,
+            stream->payloads->len - 1);
       if (GST_ASF_PAYLOAD_KF_COMPLETE (stream, payload)) {
         stream->kf_pos = stream->payloads->len - 1;
       }
@@ -423,8 +521,10 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
 
   stream = gst_asf_demux_get_stream (demux, stream_num);
 
-  if (G_UNLIKELY (stream == NULL)) {
-    if (gst_asf_demux_is_unknown_stream (demux, stream_num)) {
+  /* skip payloads of streams we don't expose without looking at them */
+  if (G_UNLIKELY (stream == NULL || stream->pruned)) {
+    if (stream == NULL
+        && gst_asf_demux_is_unknown_stream (demux, stream_num)) {
       GST_WARNING_OBJECT (demux, "Payload for unknown stream %u, skipping",
           stream_num);
     }
@@ -438,6 +538,10 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
     return TRUE;
   }
 
+  /* queues of this stream are going to change, re-evaluate it when
+   * looking for the next payload to push */
+  stream->sched_dirty = TRUE;
+
   if (!stream->is_video)
     stream->kf_pos = 0;
 
@@ -446,6 +550,15 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
 
     if (payload.rep_data_len >= 8) {
       payload.mo_size = GST_READ_UINT32_LE (payload.rep_data);
+      /* don't let corrupted packets make us allocate huge buffers */
+      if (G_UNLIKELY (demux->data_size > 0
+              && payload.mo_size > demux->data_size)) {
+        GST_WARNING_OBJECT (demux, "media object size %u is bigger than the "
+            "data object, very bad", payload.mo_size);
+        *p_data += payload_len;
+        *p_size -= payload_len;
+        return FALSE;
+      }
       payload.ts = GST_READ_UINT32_LE (payload.rep_data + 4) * GST_MSECOND;
       if (G_UNLIKELY (payload.ts < demux->preroll))
         payload.ts = 0;
@@ -458,6 +571,9 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
           GST_TIME_ARGS (payload.ts));
       GST_LOG_OBJECT (demux, "media object dur    : %" GST_TIME_FORMAT,
           GST_TIME_ARGS (payload.duration));
+
+      if (payload.mo_offset == 0 && (payload.keyframe || !stream->is_video))
+        gst_asf_demux_learn_index_entry (demux, stream, payload.ts);
     } else if (payload.rep_data_len == 0) {
       payload.mo_size = 0;
     } else if (payload.rep_data_len != 0) {
@@ -504,7 +620,9 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
           }
         }
       } else {
-        payload.buf = gst_buffer_new_allocate (NULL, payload.mo_size, NULL);    /* can we use (mo_size - offset) for size? */
+        /* can we use (mo_size - offset) for size? */
+        payload.buf =
+            gst_asf_demux_alloc_buffer (demux, stream, payload.mo_size);
         gst_buffer_fill (payload.buf, payload.mo_offset,
             payload_data, payload_len);
         payload.buf_filled = payload.mo_size - (payload.mo_offset);
@@ -528,9 +646,8 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
                 asf_payload_find_previous_fragment (demux, &payload, stream))) {
           if (prev->buf == NULL || (payload.mo_size > 0
                   && payload.mo_size != prev->mo_size)
-              || payload.mo_offset >= gst_buffer_get_size (prev->buf)
-              || payload.mo_offset + payload_len >
-              gst_buffer_get_size (prev->buf)) {
+              || payload.mo_offset >= prev->mo_size
+              || payload.mo_offset + payload_len > prev->mo_size) {
             GST_WARNING_OBJECT (demux, "Offset doesn't match previous data?!");
           } else {
             /* we assume fragments are payloaded with increasing mo_offset */
@@ -539,8 +656,17 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
                   "offset=%u vs buf_filled=%u", payload.mo_offset,
                   prev->buf_filled);
             }
-            gst_buffer_fill (prev->buf, payload.mo_offset,
-                payload_data, payload_len);
+            if (payload.mo_offset == gst_buffer_get_size (prev->buf) &&
+                gst_buffer_n_memory (prev->buf) +
+                gst_buffer_n_memory (packet->buf) <=
+                gst_buffer_get_max_memory ()) {
+              asf_packet_append_payload_memory (packet, prev->buf,
+                  payload_data, payload_len);
+            } else {
+              asf_payload_ensure_full_size (demux, stream, prev);
+              gst_buffer_fill (prev->buf, payload.mo_offset,
+                  payload_data, payload_len);
+            }
             prev->buf_filled =
                 MAX (prev->buf_filled, payload.mo_offset + payload_len);
             GST_LOG_OBJECT (demux, "Merged media object fragments, size now %u",
@@ -550,10 +676,20 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
           GST_DEBUG_OBJECT (demux, "n-th payload fragment, but don't have "
               "any previous fragment, ignoring payload");
         }
+      } else if (payload_len <= payload.mo_size &&
+          asf_payload_fragments_fit (payload.mo_size, payload_len)) {
+        GST_LOG_OBJECT (demux, "first fragment of media object of size %u",
+            payload.mo_size);
+        payload.buf = gst_buffer_copy_region (packet->buf, GST_BUFFER_COPY_ALL,
+            (guint) (payload_data - packet->bdata), payload_len);
+        payload.buf_filled = payload_len;
+
+        gst_asf_payload_queue_for_stream (demux, &payload, stream);
       } else {
         GST_LOG_OBJECT (demux, "allocating buffer of size %u for fragmented "
             "media object", payload.mo_size);
-        payload.buf = gst_buffer_new_allocate (NULL, payload.mo_size, NULL);
+        payload.buf =
+            gst_asf_demux_alloc_buffer (demux, stream, payload.mo_size);
         gst_buffer_fill (payload.buf, 0, payload_data, payload_len);
         payload.buf_filled = payload_len;
 
@@ -599,6 +735,7 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
         payload.buf = asf_packet_create_payload_buffer (packet,
             &payload_data, &payload_len, sub_payload_len);
         payload.buf_filled = sub_payload_len;
+        payload.sub_payload = TRUE;
 
         payload.ts = ts;
         if (G_LIKELY (ts_delta))
@@ -624,8 +761,11 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
   const guint8 *data;
   gboolean has_multiple_payloads;
   GstAsfDemuxParsePacketError ret = GST_ASF_DEMUX_PARSE_PACKET_ERROR_NONE;
+  GstClockTime start;
   guint8 ec_flags, flags1;
-  guint size;
+  guint size, n;
+
+  start = gst_util_get_timestamp ();
 
   gst_buffer_map (buf, &map, GST_MAP_READ);
   data = map.data;
@@ -783,12 +923,15 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
           p = &g_array_index (s->payloads_rev, AsfPayload,
               s->payloads_rev->len - 1);
           g_array_append_vals (s->payloads, p, 1);
+          if (s->payloads_idx_valid)
+            asf_payload_index_insert (s->payloads_idx, p, s->payloads->len - 1);
           if (GST_ASF_PAYLOAD_KF_COMPLETE (s, p)) {
             /* Mark position of KF for reverse play */
             s->kf_pos = s->payloads->len - 1;
           }
           g_array_remove_index (s->payloads_rev, (s->payloads_rev->len - 1));
         }
+        g_hash_table_remove_all (s->payloads_rev_idx);
       }
     }
 
@@ -804,5 +947,19 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
 
 done:
   gst_buffer_unmap (buf, &map);
+
+  if (G_LIKELY (ret == GST_ASF_DEMUX_PARSE_PACKET_ERROR_NONE))
+    g_atomic_int_inc (&demux->stat_packets_parsed);
+  else
+    g_atomic_int_inc (&demux->stat_parse_errors);
+
+  for (n = 0; n < demux->num_streams; ++n) {
+    AsfStream *s = &demux->stream[n];
+
+    g_atomic_int_set (&s->stat_queued, s->payloads ? s->payloads->len : 0);
+  }
+
+  gst_asf_demux_update_avg_time (&demux->stat_parse_time, start);
+
   return ret;
 }
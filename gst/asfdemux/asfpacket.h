@@ -43,6 +43,7 @@ typedef struct {
   gboolean      interlaced;        /* default: FALSE */
   gboolean      tff;
   gboolean      rff;
+  gboolean      sub_payload;       /* part of a compressed payload           */
 } AsfPayload;
 
 typedef struct {
@@ -73,6 +73,27 @@ GST_STATIC_PAD_TEMPLATE ("video_%u",
 /* abuse this GstFlowReturn enum for internal usage */
 #define ASF_FLOW_NEED_MORE_DATA  99
 
+#define DEFAULT_BUFFER_LIST      FALSE
+#define DEFAULT_INDEX_CACHE_DIR  NULL
+#define DEFAULT_READ_AHEAD       0
+#define DEFAULT_MAX_BITRATE      0
+
+/* reads are aligned to this when reading ahead */
+#define READ_AHEAD_ALIGN         4096
+
+/* index object entry type that points at keyframes */
+#define ASF_INDEX_TYPE_CLEANPOINT  3
+
+enum
+{
+  PROP_0,
+  PROP_BUFFER_LIST,
+  PROP_INDEX_CACHE_DIR,
+  PROP_READ_AHEAD,
+  PROP_MAX_BITRATE,
+  PROP_STATS
+};
+
 #define gst_asf_get_flow_name(flow)    \
   (flow == ASF_FLOW_NEED_MORE_DATA) ?  \
   "need-more-data" : gst_flow_get_name (flow)
@@ -80,6 +101,10 @@ GST_STATIC_PAD_TEMPLATE ("video_%u",
 GST_DEBUG_CATEGORY (asfdemux_dbg);
 
 static void gst_asf_demux_finalize (GObject * object);
+static void gst_asf_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_asf_demux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static GstStateChangeReturn gst_asf_demux_change_state (GstElement * element,
     GstStateChange transition);
 static gboolean gst_asf_demux_element_send_event (GstElement * element,
@@ -104,6 +129,11 @@ static gboolean gst_asf_demux_pull_headers (GstASFDemux * demux,
     GstFlowReturn * pflow);
 static GstFlowReturn gst_asf_demux_pull_indices (GstASFDemux * demux);
 static void gst_asf_demux_reset_stream_state_after_discont (GstASFDemux * asf);
+static void gst_asf_demux_sched_invalidate (GstASFDemux * demux);
+static void gst_asf_demux_sched_reset (GstASFDemux * demux);
+static void gst_asf_demux_save_index_cache (GstASFDemux * demux);
+static void gst_asf_demux_free_pools (GstASFDemux * demux);
+static void gst_asf_demux_prune_mbr_streams (GstASFDemux * demux);
 static gboolean
 gst_asf_demux_parse_data_object_start (GstASFDemux * demux, guint8 * data);
 static void gst_asf_demux_descramble_buffer (GstASFDemux * demux,
@@ -128,6 +158,94 @@ gst_asf_demux_class_init (GstASFDemuxClass * klass)
   gstelement_class = (GstElementClass *) klass;
 
   gobject_class->finalize = gst_asf_demux_finalize;
+  gobject_class->set_property = gst_asf_demux_set_property;
+  gobject_class->get_property = gst_asf_demux_get_property;
+
+  /**
+   * GstASFDemux:buffer-list:
+   *
+   * Push consecutive payloads of the same stream that become complete
+   * together as one #GstBufferList instead of one buffer at a time. This
+   * reduces the per-buffer overhead for streams with many small payloads,
+   * like low bitrate audio. The sub-payloads of compressed payloads are
+   * always pushed as a list.
+   */
+  g_object_class_install_property (gobject_class, PROP_BUFFER_LIST,
+      g_param_spec_boolean ("buffer-list", "Buffer List",
+          "Push consecutive payloads of a stream as buffer lists",
+          DEFAULT_BUFFER_LIST, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstASFDemux:index-cache-dir:
+   *
+   * Directory to store the index learned while playing files without a
+   * simple index in. The index is written when the demuxer is reset and
+   * loaded again the next time a file with the same file ID is played, so
+   * seeks in it can be done without estimating.
+   */
+  g_object_class_install_property (gobject_class, PROP_INDEX_CACHE_DIR,
+      g_param_spec_string ("index-cache-dir", "Index Cache Directory",
+          "Directory to cache indexes learned from files without index in "
+          "(NULL = don't cache)", DEFAULT_INDEX_CACHE_DIR,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstASFDemux:read-ahead:
+   *
+   * In pull mode, pull this many bytes from upstream at once and take
+   * packets and headers from that, instead of pulling every packet on its
+   * own. Larger values mean fewer reads, which helps with slow disks and
+   * network file systems.
+   */
+  g_object_class_install_property (gobject_class, PROP_READ_AHEAD,
+      g_param_spec_uint ("read-ahead", "Read Ahead",
+          "Number of bytes to read at once in pull mode (0 = disabled)",
+          0, 64 * 1024 * 1024, DEFAULT_READ_AHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstASFDemux:max-bitrate:
+   *
+   * For multi-bitrate files, only expose the variant with the highest
+   * bitrate not above this one from each group of mutually exclusive
+   * streams, or the lowest bitrate variant if all are above it. Payloads of
+   * the other variants are skipped without being parsed. Takes effect when
+   * the next file header is parsed.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_BITRATE,
+      g_param_spec_uint ("max-bitrate", "Max Bitrate",
+          "Maximum bitrate of the variant to pick from multi-bitrate files, "
+          "in bits per second (0 = expose all variants)",
+          0, G_MAXUINT, DEFAULT_MAX_BITRATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstASFDemux:stats:
+   *
+   * Various statistics. This property returns a GstStructure with name
+   * application/x-asfdemux-stats with the following fields:
+   *
+   * - "buffers-allocated"  G_TYPE_UINT  buffers allocated without a pool
+   * - "buffers-pooled"     G_TYPE_UINT  buffers taken from the internal pools
+   * - "buffers-downstream" G_TYPE_UINT  buffers taken from downstream pools
+   * - "packets-parsed"     G_TYPE_UINT  data packets parsed successfully
+   * - "parse-errors"       G_TYPE_UINT  data packets that failed to parse
+   * - "adapter-bytes"      G_TYPE_UINT  bytes waiting in the input adapter
+   * - "parse-time"         G_TYPE_UINT64  average time to parse a packet, in
+   *                        nanoseconds
+   * - "push-time"          G_TYPE_UINT64  average time downstream takes to
+   *                        accept a buffer or list, in nanoseconds
+   * - "queue-depths"       GST_TYPE_ARRAY  number of payloads queued per
+   *                        stream after the last packet, in stream order
+   *
+   * The averages are moving averages over roughly the last 16 packets or
+   * pushes. All values are updated atomically, so this is cheap enough to be
+   * polled while playing.
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Various statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class, "ASF Demuxer",
       "Codec/Demuxer",
@@ -150,6 +268,17 @@ static void
 gst_asf_demux_free_stream (GstASFDemux * demux, AsfStream * stream)
 {
   gst_caps_replace (&stream->caps, NULL);
+  if (stream->pool) {
+    gst_buffer_pool_set_active (stream->pool, FALSE);
+    gst_object_unref (stream->pool);
+    stream->pool = NULL;
+  }
+  g_free (stream->idx_entries);
+  stream->idx_entries = NULL;
+  stream->idx_num_entries = 0;
+  g_free (stream->ds_perm);
+  stream->ds_perm = NULL;
+  stream->ds_perm_len = 0;
   if (stream->pending_tags) {
     gst_tag_list_unref (stream->pending_tags);
     stream->pending_tags = NULL;
@@ -195,6 +324,16 @@ gst_asf_demux_free_stream (GstASFDemux * demux, AsfStream * stream)
     stream->payloads_rev = NULL;
   }
 
+  if (stream->payloads_idx) {
+    g_hash_table_destroy (stream->payloads_idx);
+    stream->payloads_idx = NULL;
+  }
+
+  if (stream->payloads_rev_idx) {
+    g_hash_table_destroy (stream->payloads_rev_idx);
+    stream->payloads_rev_idx = NULL;
+  }
+
   if (stream->ext_props.valid) {
     g_free (stream->ext_props.payload_extensions);
     stream->ext_props.payload_extensions = NULL;
@@ -206,6 +345,16 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
 {
   GST_LOG_OBJECT (demux, "resetting");
 
+  gst_asf_demux_save_index_cache (demux);
+  gst_asf_demux_free_pools (demux);
+  g_array_set_size (demux->lidx, 0);
+  demux->lidx_last = -1;
+  gst_buffer_replace (&demux->ra_buf, NULL);
+  demux->ra_offset = 0;
+  demux->lidx_stream = 0;
+  demux->lidx_dirty = FALSE;
+  memset (&demux->file_guid, 0, sizeof (demux->file_guid));
+
   gst_segment_init (&demux->segment, GST_FORMAT_UNDEFINED);
   demux->segment_running = FALSE;
   if (demux->adapter && !chain_reset) {
@@ -213,6 +362,7 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
     g_object_unref (demux->adapter);
     demux->adapter = NULL;
   }
+  g_atomic_int_set (&demux->stat_adapter_bytes, 0);
   if (demux->taglist) {
     gst_tag_list_unref (demux->taglist);
     demux->taglist = NULL;
@@ -231,6 +381,8 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
     g_slist_free (demux->mut_ex_streams);
     demux->mut_ex_streams = NULL;
   }
+  memset (demux->mbr_group, 0, sizeof (demux->mbr_group));
+  demux->num_mbr_groups = 0;
 
   demux->state = GST_ASF_DEMUX_STATE_HEADER;
   g_free (demux->objpath);
@@ -264,6 +416,7 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
     --demux->num_streams;
   }
   memset (demux->stream, 0, sizeof (demux->stream));
+  demux->sched_heap_len = 0;
   if (!chain_reset) {
     /* do not remove those for not adding pads with same name */
     demux->num_audio_streams = 0;
@@ -285,6 +438,7 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
   demux->sidx_num_entries = 0;
   g_free (demux->sidx_entries);
   demux->sidx_entries = NULL;
+  demux->stream_index = FALSE;
 
   demux->speed_packets = 1;
 
@@ -324,6 +478,12 @@ gst_asf_demux_init (GstASFDemux * demux)
       GST_DEBUG_FUNCPTR (gst_asf_demux_activate_mode));
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
+  demux->buffer_list = DEFAULT_BUFFER_LIST;
+  demux->index_cache_dir = g_strdup (DEFAULT_INDEX_CACHE_DIR);
+  demux->read_ahead = DEFAULT_READ_AHEAD;
+  demux->max_bitrate = DEFAULT_MAX_BITRATE;
+  demux->lidx = g_array_new (FALSE, FALSE, sizeof (AsfLearnedIndexEntry));
+
   /* set initial state */
   gst_asf_demux_reset (demux, FALSE);
 }
@@ -468,6 +628,7 @@ gst_asf_demux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       GST_OBJECT_LOCK (demux);
       gst_adapter_clear (demux->adapter);
       GST_OBJECT_UNLOCK (demux);
+      g_atomic_int_set (&demux->stat_adapter_bytes, 0);
       gst_asf_demux_send_event_unlocked (demux, event);
       break;
     }
@@ -490,6 +651,260 @@ gst_asf_demux_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
   return ret;
 }
 
+static gchar *
+gst_asf_demux_get_index_cache_filename (GstASFDemux * demux)
+{
+  gchar *filename = NULL;
+  gchar *name;
+
+  GST_OBJECT_LOCK (demux);
+  if (demux->index_cache_dir != NULL) {
+    name = g_strdup_printf ("%08x%08x%08x%08x.asfidx", demux->file_guid.v1,
+        demux->file_guid.v2, demux->file_guid.v3, demux->file_guid.v4);
+    filename = g_build_filename (demux->index_cache_dir, name, NULL);
+    g_free (name);
+  }
+  GST_OBJECT_UNLOCK (demux);
+
+  return filename;
+}
+
+static void
+gst_asf_demux_load_index_cache (GstASFDemux * demux)
+{
+  gchar *filename;
+
+  if (demux->broadcast || demux->num_packets == 0)
+    return;
+
+  filename = gst_asf_demux_get_index_cache_filename (demux);
+  if (filename == NULL)
+    return;
+
+  if (asf_learned_index_load (demux->lidx, &demux->lidx_stream, filename,
+          demux->num_packets, demux->packet_size)) {
+    GST_INFO_OBJECT (demux, "loaded learned index with %u entries from %s",
+        demux->lidx->len, filename);
+  }
+  g_free (filename);
+}
+
+static void
+gst_asf_demux_save_index_cache (GstASFDemux * demux)
+{
+  gchar *filename;
+
+  if (!demux->lidx_dirty || demux->lidx_stream == 0)
+    return;
+
+  filename = gst_asf_demux_get_index_cache_filename (demux);
+  if (filename == NULL)
+    return;
+
+  asf_learned_index_save (demux->lidx, demux->lidx_stream, filename,
+      demux->num_packets, demux->packet_size);
+  demux->lidx_dirty = FALSE;
+  g_free (filename);
+}
+
+/* called for the start of each keyframe, or of each media object for other
+ * than video streams, while parsing packets */
+void
+gst_asf_demux_learn_index_entry (GstASFDemux * demux, AsfStream * stream,
+    GstClockTime ts)
+{
+  guint i;
+
+  /* no need if we have a real index; without a packet count we can't use
+   * it, and we can only learn if we know where we are */
+  if (demux->sidx_num_entries > 0 || demux->stream_index ||
+      demux->num_packets == 0 ||
+      demux->packet < 0 || demux->speed_packets != 1 ||
+      GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) ||
+      !GST_CLOCK_TIME_IS_VALID (ts))
+    return;
+
+  /* learn from the video stream with the lowest number, if any, among the
+   * ones we actually get payloads for */
+  if (G_UNLIKELY (demux->lidx_stream == 0)) {
+    AsfStream *best = NULL;
+
+    for (i = 0; i < demux->num_streams; ++i) {
+      AsfStream *s = &demux->stream[i];
+
+      if (s->pruned || (demux->activated_streams && !s->active))
+        continue;
+
+      if (best == NULL || (s->is_video && !best->is_video) ||
+          (s->is_video == best->is_video && s->id < best->id))
+        best = s;
+    }
+    if (best == NULL)
+      return;
+    demux->lidx_stream = best->id;
+    GST_DEBUG_OBJECT (demux, "learning index from stream %u", best->id);
+  }
+
+  if (stream->id != demux->lidx_stream)
+    return;
+
+  if (asf_learned_index_add (demux->lidx, &demux->lidx_last, ts,
+          (guint32) demux->packet)) {
+    GST_LOG_OBJECT (demux, "learned %" GST_TIME_FORMAT " => packet %u",
+        GST_TIME_ARGS (ts), (guint) demux->packet);
+    demux->lidx_dirty = TRUE;
+  }
+}
+
+static gboolean
+gst_asf_demux_learned_index_lookup (GstASFDemux * demux, guint * packet,
+    GstClockTime seek_time, GstClockTime * p_idx_time, guint * speed,
+    gboolean next)
+{
+  GstClockTime offset, idx_time;
+  guint32 idx_packet;
+
+  /* entries have the timestamps of the packets, before subtracting first_ts */
+  offset = GST_CLOCK_TIME_IS_VALID (demux->first_ts) ? demux->first_ts : 0;
+
+  if (!asf_learned_index_lookup (demux->lidx, seek_time + offset, next,
+          &idx_packet, &idx_time))
+    return FALSE;
+
+  if (idx_time > offset)
+    idx_time -= offset;
+  else
+    idx_time = 0;
+
+  *packet = idx_packet;
+  if (speed)
+    *speed = 1;
+
+  GST_DEBUG_OBJECT (demux, "%" GST_TIME_FORMAT " => packet %u at %"
+      GST_TIME_FORMAT " (learned index)", GST_TIME_ARGS (seek_time), *packet,
+      GST_TIME_ARGS (idx_time));
+
+  if (p_idx_time)
+    *p_idx_time = idx_time;
+
+  return TRUE;
+}
+
+/* looks up the packet to start from in the per-stream indexes. Streams
+ * are handled independently, and the earliest packet any of them needs is
+ * used; for key unit seeks only video streams are considered, if there are
+ * any with an index, so each of them starts on a keyframe.
+ *
+ * Only cleanpoint indexes point at keyframes. With the other index types we
+ * just start from the packet with the data for the seek position and read
+ * forward to the next keyframe, so no index time is returned then. The
+ * time of a cleanpoint entry is an upper bound of the keyframe timestamp,
+ * the segment start is moved back to the real one once it has been read */
+static gboolean
+gst_asf_demux_stream_index_lookup (GstASFDemux * demux, guint * packet,
+    GstClockTime seek_time, GstClockTime * p_idx_time, gboolean next,
+    gboolean * eos)
+{
+  GstClockTime idx_time = GST_CLOCK_TIME_NONE;
+  GstClockTime ts;
+  gboolean video_only = FALSE;
+  gboolean cleanpoints = TRUE;
+  gboolean at_end = FALSE;
+  guint32 idx_packet = G_MAXUINT32;
+  guint i;
+
+  if (!demux->stream_index)
+    return FALSE;
+
+  if (demux->keyunit_sync) {
+    for (i = 0; i < demux->num_streams; ++i) {
+      AsfStream *stream = &demux->stream[i];
+
+      if (stream->is_video && stream->idx_num_entries > 0 &&
+          (stream->active || !demux->activated_streams))
+        video_only = TRUE;
+    }
+  }
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+
+    if (stream->idx_num_entries == 0)
+      continue;
+    if (demux->activated_streams && !stream->active)
+      continue;
+    if (video_only && !stream->is_video)
+      continue;
+    if (stream->idx_type != ASF_INDEX_TYPE_CLEANPOINT)
+      cleanpoints = FALSE;
+  }
+
+  /* index entries are presentation times, which include the preroll */
+  ts = seek_time + demux->preroll;
+
+  for (i = 0; i < demux->num_streams; ++i) {
+    AsfStream *stream = &demux->stream[i];
+    AsfIndexEntry *entry;
+    gint pos;
+
+    if (stream->idx_num_entries == 0)
+      continue;
+    /* don't care about streams we don't output */
+    if (demux->activated_streams && !stream->active)
+      continue;
+    if (video_only && !stream->is_video)
+      continue;
+
+    pos = asf_index_find_entry (stream->idx_entries, stream->idx_num_entries,
+        ts);
+
+    if (next && cleanpoints) {
+      /* next keyframe after the one we'd get otherwise */
+      if (pos + 1 >= (gint) stream->idx_num_entries) {
+        at_end = TRUE;
+        continue;
+      }
+      ++pos;
+    } else if (pos < 0) {
+      pos = 0;
+    }
+
+    entry = &stream->idx_entries[pos];
+    GST_LOG_OBJECT (stream->pad, "%" GST_TIME_FORMAT " => packet %u (type %u)",
+        GST_TIME_ARGS (seek_time), entry->packet, stream->idx_type);
+
+    if (entry->packet < idx_packet) {
+      idx_packet = entry->packet;
+      idx_time = entry->ts;
+    }
+  }
+
+  if (idx_packet == G_MAXUINT32) {
+    /* asking for the next keyframe after the last one */
+    if (at_end && eos)
+      *eos = TRUE;
+    return FALSE;
+  }
+
+  if (!cleanpoints)
+    idx_time = GST_CLOCK_TIME_NONE;
+  else if (G_LIKELY (idx_time >= demux->preroll))
+    idx_time -= demux->preroll;
+  else
+    idx_time = 0;
+
+  *packet = idx_packet;
+
+  GST_DEBUG_OBJECT (demux, "%" GST_TIME_FORMAT " => packet %u at %"
+      GST_TIME_FORMAT " (stream index)", GST_TIME_ARGS (seek_time), *packet,
+      GST_TIME_ARGS (idx_time));
+
+  if (G_LIKELY (p_idx_time))
+    *p_idx_time = idx_time;
+
+  return TRUE;
+}
+
 static gboolean
 gst_asf_demux_seek_index_lookup (GstASFDemux * demux, guint * packet,
     GstClockTime seek_time, GstClockTime * p_idx_time, guint * speed,
@@ -501,9 +916,20 @@ gst_asf_demux_seek_index_lookup (GstASFDemux * demux, guint * packet,
   if (eos)
     *eos = FALSE;
 
-  if (G_UNLIKELY (demux->sidx_num_entries == 0 || demux->sidx_interval == 0))
+  if (gst_asf_demux_stream_index_lookup (demux, packet, seek_time, p_idx_time,
+          next, eos)) {
+    if (speed)
+      *speed = 1;
+    return TRUE;
+  }
+
+  if (eos && *eos)
     return FALSE;
 
+  if (G_UNLIKELY (demux->sidx_num_entries == 0 || demux->sidx_interval == 0))
+    return gst_asf_demux_learned_index_lookup (demux, packet, seek_time,
+        p_idx_time, speed, next);
+
   idx = (guint) ((seek_time + demux->preroll) / demux->sidx_interval);
 
   if (next) {
@@ -563,6 +989,7 @@ gst_asf_demux_reset_stream_state_after_discont (GstASFDemux * demux)
   guint n;
 
   gst_adapter_clear (demux->adapter);
+  g_atomic_int_set (&demux->stat_adapter_bytes, 0);
 
   GST_DEBUG_OBJECT (demux, "reset stream state");
 
@@ -580,7 +1007,13 @@ gst_asf_demux_reset_stream_state_after_discont (GstASFDemux * demux)
       gst_buffer_replace (&payload->buf, NULL);
       g_array_remove_index (demux->stream[n].payloads, last);
     }
+    demux->stream[n].payloads_idx_valid = FALSE;
   }
+
+  gst_asf_demux_sched_reset (demux);
+
+  /* we can't tell anymore whether we missed keyframes */
+  demux->lidx_last = -1;
 }
 
 static void
@@ -615,12 +1048,16 @@ gst_asf_demux_handle_seek_push (GstASFDemux * demux, GstEvent * event)
 
   GST_DEBUG_OBJECT (demux, "seeking to %" GST_TIME_FORMAT, GST_TIME_ARGS (cur));
 
-  /* determine packet, by index or by estimation */
+  /* determine packet, by index or by estimation. Every seek costs a new
+   * connection with http, so better estimate from the positions we learned
+   * while playing than from the average bitrate */
   if (!gst_asf_demux_seek_index_lookup (demux, &packet, cur, NULL, NULL, FALSE,
           NULL)) {
-    packet =
-        (guint) gst_util_uint64_scale (demux->num_packets, cur,
-        demux->play_time);
+    GstClockTime offset;
+
+    offset = GST_CLOCK_TIME_IS_VALID (demux->first_ts) ? demux->first_ts : 0;
+    packet = asf_learned_index_estimate (demux->lidx, cur + offset, offset,
+        demux->play_time + offset, demux->num_packets);
   }
 
   if (packet > demux->num_packets) {
@@ -805,7 +1242,8 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
         packet = demux->num_packets;
     }
   } else {
-    if (G_LIKELY (demux->keyunit_sync && !demux->accurate)) {
+    if (G_LIKELY (demux->keyunit_sync && !demux->accurate &&
+            GST_CLOCK_TIME_IS_VALID (idx_time))) {
       GST_DEBUG_OBJECT (demux, "key unit seek, adjust seek_time = %"
           GST_TIME_FORMAT " to index_time = %" GST_TIME_FORMAT,
           GST_TIME_ARGS (seek_time), GST_TIME_ARGS (idx_time));
@@ -941,8 +1379,11 @@ gst_asf_demux_release_old_pads (GstASFDemux * demux)
   GST_DEBUG_OBJECT (demux, "Releasing old pads");
 
   while (demux->old_num_streams > 0) {
-    gst_pad_push_event (demux->old_stream[demux->old_num_streams - 1].pad,
-        gst_event_new_eos ());
+    AsfStream *old = &demux->old_stream[demux->old_num_streams - 1];
+
+    /* pads taken over by the new streams have been swapped out already */
+    if (old->active)
+      gst_pad_push_event (old->pad, gst_event_new_eos ());
     gst_asf_demux_free_stream (demux,
         &demux->old_stream[demux->old_num_streams - 1]);
     --demux->old_num_streams;
@@ -1022,12 +1463,76 @@ parse_failed:
   }
 }
 
+/* takes @size bytes at @offset from the read-ahead buffer, refilling it with
+ * a chunk of @read_ahead bytes around @offset first if needed. Returns FALSE
+ * if the data couldn't be read this way, e.g. at the end of the file; the
+ * caller then pulls the data directly, which takes care of reporting errors */
+static gboolean
+gst_asf_demux_pull_data_read_ahead (GstASFDemux * demux, guint64 offset,
+    guint size, guint read_ahead, GstBuffer ** p_buf)
+{
+  GstBuffer *buf = NULL;
+  GstFlowReturn flow;
+  guint64 start;
+  guint length;
+
+  if (demux->ra_buf == NULL || offset < demux->ra_offset ||
+      offset + size > demux->ra_offset + gst_buffer_get_size (demux->ra_buf)) {
+    gst_buffer_replace (&demux->ra_buf, NULL);
+
+    /* in reverse playback the next packets are the ones before this one */
+    if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) &&
+        offset + size > read_ahead)
+      start = offset + size - read_ahead;
+    else
+      start = offset;
+
+    /* aligning the start moves the window down, grow it by as much so that
+     * it still covers the requested data */
+    length = read_ahead + start % READ_AHEAD_ALIGN;
+    start -= start % READ_AHEAD_ALIGN;
+    length += READ_AHEAD_ALIGN - 1;
+    length -= length % READ_AHEAD_ALIGN;
+
+    GST_LOG_OBJECT (demux, "reading ahead %u bytes at %" G_GUINT64_FORMAT,
+        length, start);
+
+    flow = gst_pad_pull_range (demux->sinkpad, start, length, &buf);
+    if (flow != GST_FLOW_OK)
+      return FALSE;
+
+    demux->ra_buf = buf;
+    demux->ra_offset = start;
+
+    if (offset + size > start + gst_buffer_get_size (buf))
+      return FALSE;
+  }
+
+  *p_buf = gst_buffer_copy_region (demux->ra_buf, GST_BUFFER_COPY_ALL,
+      offset - demux->ra_offset, size);
+
+  return TRUE;
+}
+
 static gboolean
 gst_asf_demux_pull_data (GstASFDemux * demux, guint64 offset, guint size,
     GstBuffer ** p_buf, GstFlowReturn * p_flow)
 {
   gsize buffer_size;
   GstFlowReturn flow;
+  guint read_ahead;
+
+  GST_OBJECT_LOCK (demux);
+  read_ahead = demux->read_ahead;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (size < read_ahead &&
+      gst_asf_demux_pull_data_read_ahead (demux, offset, size, read_ahead,
+          p_buf)) {
+    if (G_LIKELY (p_flow))
+      *p_flow = GST_FLOW_OK;
+    return TRUE;
+  }
 
   GST_LOG_OBJECT (demux, "pulling buffer at %" G_GUINT64_FORMAT "+%u",
       offset, size);
@@ -1183,6 +1688,10 @@ gst_asf_demux_parse_data_object_start (GstASFDemux * demux, guint8 * data)
   /* process pending stream objects and create pads for those */
   gst_asf_demux_process_queued_extended_stream_objects (demux);
 
+  gst_asf_demux_prune_mbr_streams (demux);
+
+  gst_asf_demux_load_index_cache (demux);
+
   GST_INFO_OBJECT (demux, "Stream has %" G_GUINT64_FORMAT " packets, "
       "data_offset=%" G_GINT64_FORMAT ", data_size=%" G_GINT64_FORMAT
       ", index_offset=%" G_GUINT64_FORMAT, demux->num_packets,
@@ -1314,6 +1823,10 @@ all_streams_prerolled (GstASFDemux * demux)
 
     stream = &demux->stream[i];
 
+    /* we'll never get data for these */
+    if (stream->pruned)
+      continue;
+
     all_types |= stream->type;
 
     if (G_UNLIKELY (stream->payloads->len == 0)) {
@@ -1483,6 +1996,8 @@ gst_asf_demux_get_first_ts (GstASFDemux * demux)
         }
       }
     }
+
+    gst_asf_demux_sched_invalidate (demux);
   }
 
   gst_asf_demux_check_segment_ts (demux, 0);
@@ -1548,6 +2063,70 @@ gst_asf_demux_update_caps_from_payload (GstASFDemux * demux, AsfStream * stream)
   }
 }
 
+static guint32
+gst_asf_demux_get_stream_bitrate (AsfStream * stream)
+{
+  if (stream->bitrate == 0 && stream->ext_props.valid)
+    return stream->ext_props.data_bitrate;
+
+  return stream->bitrate;
+}
+
+/* marks all but one stream of each group of bitrate variants as pruned, so
+ * their payloads get skipped right after the payload header is parsed */
+static void
+gst_asf_demux_prune_mbr_streams (GstASFDemux * demux)
+{
+  guint max_bitrate, group, i;
+
+  GST_OBJECT_LOCK (demux);
+  max_bitrate = demux->max_bitrate;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (max_bitrate == 0)
+    return;
+
+  for (group = 1; group <= demux->num_mbr_groups; ++group) {
+    AsfStream *best = NULL;
+    guint32 best_rate = 0;
+
+    /* highest bitrate that fits, or the lowest one if none fits */
+    for (i = 0; i < demux->num_streams; ++i) {
+      AsfStream *stream = &demux->stream[i];
+      guint32 rate;
+      gboolean better;
+
+      if (demux->mbr_group[stream->id & 0x7f] != group)
+        continue;
+
+      rate = gst_asf_demux_get_stream_bitrate (stream);
+      if (best == NULL)
+        better = TRUE;
+      else if (rate <= max_bitrate)
+        better = (best_rate > max_bitrate || rate > best_rate);
+      else
+        better = (best_rate > max_bitrate && rate < best_rate);
+
+      if (better) {
+        best = stream;
+        best_rate = rate;
+      }
+    }
+
+    for (i = 0; i < demux->num_streams; ++i) {
+      AsfStream *stream = &demux->stream[i];
+
+      if (demux->mbr_group[stream->id & 0x7f] != group)
+        continue;
+
+      stream->pruned = (stream != best);
+      GST_INFO_OBJECT (demux, "%s stream %u with bitrate %u",
+          stream->pruned ? "pruning" : "keeping", stream->id,
+          gst_asf_demux_get_stream_bitrate (stream));
+    }
+  }
+}
+
 static gboolean
 gst_asf_demux_check_activate_streams (GstASFDemux * demux, gboolean force)
 {
@@ -1600,6 +2179,212 @@ gst_asf_demux_check_activate_streams (GstASFDemux * demux, gboolean force)
   return TRUE;
 }
 
+/* Streams that have a complete payload to push are kept in a binary min-heap
+ * ordered by the timestamp of that payload, so finding the next payload to
+ * push doesn't require walking all streams and their queues after every
+ * packet. A stream is only re-evaluated when its payload queue changed. */
+static inline gboolean
+gst_asf_demux_sched_less (AsfStream * a, AsfStream * b)
+{
+  /* same order as iterating the streams array would give us on equal ts */
+  if (a->sched_ts != b->sched_ts)
+    return a->sched_ts < b->sched_ts;
+  return a < b;
+}
+
+static inline void
+gst_asf_demux_sched_set (GstASFDemux * demux, guint pos, AsfStream * stream)
+{
+  demux->sched_heap[pos] = stream;
+  stream->sched_pos = pos;
+}
+
+static void
+gst_asf_demux_sched_sift_up (GstASFDemux * demux, guint pos)
+{
+  AsfStream *stream = demux->sched_heap[pos];
+
+  while (pos > 0) {
+    guint parent = (pos - 1) / 2;
+
+    if (!gst_asf_demux_sched_less (stream, demux->sched_heap[parent]))
+      break;
+    gst_asf_demux_sched_set (demux, pos, demux->sched_heap[parent]);
+    pos = parent;
+  }
+  gst_asf_demux_sched_set (demux, pos, stream);
+}
+
+static void
+gst_asf_demux_sched_sift_down (GstASFDemux * demux, guint pos)
+{
+  AsfStream *stream = demux->sched_heap[pos];
+
+  while (TRUE) {
+    guint child = 2 * pos + 1;
+
+    if (child >= demux->sched_heap_len)
+      break;
+    if (child + 1 < demux->sched_heap_len &&
+        gst_asf_demux_sched_less (demux->sched_heap[child + 1],
+            demux->sched_heap[child]))
+      ++child;
+    if (!gst_asf_demux_sched_less (demux->sched_heap[child], stream))
+      break;
+    gst_asf_demux_sched_set (demux, pos, demux->sched_heap[child]);
+    pos = child;
+  }
+  gst_asf_demux_sched_set (demux, pos, stream);
+}
+
+static void
+gst_asf_demux_sched_update (GstASFDemux * demux, AsfStream * stream,
+    GstClockTime ts)
+{
+  stream->sched_ts = ts;
+
+  if (stream->sched_pos < 0) {
+    g_assert (demux->sched_heap_len < GST_ASF_DEMUX_NUM_STREAMS);
+    gst_asf_demux_sched_set (demux, demux->sched_heap_len++, stream);
+  }
+  gst_asf_demux_sched_sift_up (demux, stream->sched_pos);
+  gst_asf_demux_sched_sift_down (demux, stream->sched_pos);
+}
+
+static void
+gst_asf_demux_sched_remove (GstASFDemux * demux, AsfStream * stream)
+{
+  AsfStream *last;
+  guint pos;
+
+  if (stream->sched_pos < 0)
+    return;
+
+  pos = stream->sched_pos;
+  stream->sched_pos = -1;
+
+  if (pos != --demux->sched_heap_len) {
+    last = demux->sched_heap[demux->sched_heap_len];
+    gst_asf_demux_sched_set (demux, pos, last);
+    gst_asf_demux_sched_sift_up (demux, pos);
+    gst_asf_demux_sched_sift_down (demux, last->sched_pos);
+  }
+}
+
+/* re-evaluate all streams, e.g. after the segment or timestamps changed */
+static void
+gst_asf_demux_sched_invalidate (GstASFDemux * demux)
+{
+  guint i;
+
+  for (i = 0; i < demux->num_streams; ++i)
+    demux->stream[i].sched_dirty = TRUE;
+}
+
+static void
+gst_asf_demux_sched_reset (GstASFDemux * demux)
+{
+  guint i;
+
+  demux->sched_heap_len = 0;
+  for (i = 0; i < demux->num_streams; ++i) {
+    demux->stream[i].sched_pos = -1;
+    demux->stream[i].sched_dirty = TRUE;
+  }
+}
+
+/* returns the complete payload queued for this stream that should be pushed
+ * next, or NULL if there is none or we shouldn't push anything yet */
+static AsfPayload *
+gst_asf_demux_find_complete_payload_for_stream (GstASFDemux * demux,
+    AsfStream * stream)
+{
+  AsfPayload *payload = NULL;
+  gint last_idx;
+  int j;
+
+  /* Don't push any data until we have at least one payload that falls within
+   * the current segment. This way we can remove out-of-segment payloads that
+   * don't need to be decoded after a seek, sending only data from the
+   * keyframe directly before our segment start */
+  if (stream->payloads->len == 0)
+    return NULL;
+
+  if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+    /* Reverse playback */
+
+    if (stream->is_video) {
+      /* We have to push payloads from KF to the first frame we accumulated (reverse order) */
+      if (stream->reverse_kf_ready) {
+        payload =
+            &g_array_index (stream->payloads, AsfPayload, stream->kf_pos);
+        if (G_UNLIKELY (!GST_CLOCK_TIME_IS_VALID (payload->ts))) {
+          /* TODO : remove payload from the list? */
+          return NULL;
+        }
+      } else {
+        return NULL;
+      }
+    } else {
+      /* find first complete payload with timestamp */
+      for (j = stream->payloads->len - 1;
+          j >= 0 && (payload == NULL
+              || !GST_CLOCK_TIME_IS_VALID (payload->ts)); --j) {
+        payload = &g_array_index (stream->payloads, AsfPayload, j);
+      }
+
+      /* If there's a complete payload queued for this stream */
+      if (!gst_asf_payload_is_complete (payload))
+        return NULL;
+
+    }
+  } else {
+
+    /* find last payload with timestamp */
+    for (last_idx = stream->payloads->len - 1;
+        last_idx >= 0 && (payload == NULL
+            || !GST_CLOCK_TIME_IS_VALID (payload->ts)); --last_idx) {
+      payload = &g_array_index (stream->payloads, AsfPayload, last_idx);
+    }
+
+    /* if this is first payload after seek we might need to update the segment */
+    if (GST_CLOCK_TIME_IS_VALID (payload->ts))
+      gst_asf_demux_check_segment_ts (demux, payload->ts);
+
+    if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (payload->ts) &&
+            (payload->ts < demux->segment.start))) {
+      if (G_UNLIKELY ((demux->keyunit_sync) && (!demux->accurate)
+              && payload->keyframe)) {
+        GST_DEBUG_OBJECT (stream->pad,
+            "Found keyframe, updating segment start to %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (payload->ts));
+        demux->segment.start = payload->ts;
+        demux->segment.time = payload->ts;
+      } else {
+        GST_DEBUG_OBJECT (stream->pad, "Last queued payload has timestamp %"
+            GST_TIME_FORMAT " which is before our segment start %"
+            GST_TIME_FORMAT ", not pushing yet",
+            GST_TIME_ARGS (payload->ts),
+            GST_TIME_ARGS (demux->segment.start));
+        return NULL;
+      }
+    }
+    payload = NULL;
+    /* find first complete payload with timestamp */
+    for (j = 0;
+        j < stream->payloads->len && (payload == NULL
+            || !GST_CLOCK_TIME_IS_VALID (payload->ts)); ++j) {
+      payload = &g_array_index (stream->payloads, AsfPayload, j);
+    }
+
+    /* Now see if there's a complete payload queued for this stream */
+    if (!gst_asf_payload_is_complete (payload))
+      return NULL;
+  }
+
+  return payload;
+}
+
 /* returns the stream that has a complete payload with the lowest timestamp
  * queued, or NULL (we push things by timestamp because during the internal
  * prerolling we might accumulate more data then the external queues can take,
@@ -1607,112 +2392,88 @@ gst_asf_demux_check_activate_streams (GstASFDemux * demux, gboolean force)
 static AsfStream *
 gst_asf_demux_find_stream_with_complete_payload (GstASFDemux * demux)
 {
-  AsfPayload *best_payload = NULL;
-  AsfStream *best_stream = NULL;
+  GstClockTime segment_start;
   guint i;
 
+again:
+  segment_start = demux->segment.start;
+
   for (i = 0; i < demux->num_streams; ++i) {
     AsfStream *stream;
-    int j;
+    AsfPayload *payload;
 
     stream = &demux->stream[i];
 
-    /* Don't push any data until we have at least one payload that falls within
-     * the current segment. This way we can remove out-of-segment payloads that
-     * don't need to be decoded after a seek, sending only data from the
-     * keyframe directly before our segment start */
-    if (stream->payloads->len > 0) {
-      AsfPayload *payload = NULL;
-      gint last_idx;
-
-      if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
-        /* Reverse playback */
-
-        if (stream->is_video) {
-          /* We have to push payloads from KF to the first frame we accumulated (reverse order) */
-          if (stream->reverse_kf_ready) {
-            payload =
-                &g_array_index (stream->payloads, AsfPayload, stream->kf_pos);
-            if (G_UNLIKELY (!GST_CLOCK_TIME_IS_VALID (payload->ts))) {
-              /* TODO : remove payload from the list? */
-              continue;
-            }
-          } else {
-            continue;
-          }
-        } else {
-          /* find first complete payload with timestamp */
-          for (j = stream->payloads->len - 1;
-              j >= 0 && (payload == NULL
-                  || !GST_CLOCK_TIME_IS_VALID (payload->ts)); --j) {
-            payload = &g_array_index (stream->payloads, AsfPayload, j);
-          }
+    if (!stream->sched_dirty)
+      continue;
 
-          /* If there's a complete payload queued for this stream */
-          if (!gst_asf_payload_is_complete (payload))
-            continue;
+    stream->sched_dirty = FALSE;
 
-        }
-      } else {
+    payload = gst_asf_demux_find_complete_payload_for_stream (demux, stream);
+    if (payload)
+      gst_asf_demux_sched_update (demux, stream, payload->ts);
+    else
+      gst_asf_demux_sched_remove (demux, stream);
 
-        /* find last payload with timestamp */
-        for (last_idx = stream->payloads->len - 1;
-            last_idx >= 0 && (payload == NULL
-                || !GST_CLOCK_TIME_IS_VALID (payload->ts)); --last_idx) {
-          payload = &g_array_index (stream->payloads, AsfPayload, last_idx);
-        }
+    /* the segment start decides whether other streams may push already */
+    if (G_UNLIKELY (demux->segment.start != segment_start)) {
+      gst_asf_demux_sched_invalidate (demux);
+      goto again;
+    }
+  }
 
-        /* if this is first payload after seek we might need to update the segment */
-        if (GST_CLOCK_TIME_IS_VALID (payload->ts))
-          gst_asf_demux_check_segment_ts (demux, payload->ts);
-
-        if (G_UNLIKELY (GST_CLOCK_TIME_IS_VALID (payload->ts) &&
-                (payload->ts < demux->segment.start))) {
-          if (G_UNLIKELY ((demux->keyunit_sync) && (!demux->accurate)
-                  && payload->keyframe)) {
-            GST_DEBUG_OBJECT (stream->pad,
-                "Found keyframe, updating segment start to %" GST_TIME_FORMAT,
-                GST_TIME_ARGS (payload->ts));
-            demux->segment.start = payload->ts;
-            demux->segment.time = payload->ts;
-          } else {
-            GST_DEBUG_OBJECT (stream->pad, "Last queued payload has timestamp %"
-                GST_TIME_FORMAT " which is before our segment start %"
-                GST_TIME_FORMAT ", not pushing yet",
-                GST_TIME_ARGS (payload->ts),
-                GST_TIME_ARGS (demux->segment.start));
-            continue;
-          }
-        }
-        payload = NULL;
-        /* find first complete payload with timestamp */
-        for (j = 0;
-            j < stream->payloads->len && (payload == NULL
-                || !GST_CLOCK_TIME_IS_VALID (payload->ts)); ++j) {
-          payload = &g_array_index (stream->payloads, AsfPayload, j);
-        }
+  if (demux->sched_heap_len == 0)
+    return NULL;
 
-        /* Now see if there's a complete payload queued for this stream */
-        if (!gst_asf_payload_is_complete (payload))
-          continue;
-      }
+  return demux->sched_heap[0];
+}
 
-      /* ... and whether its timestamp is lower than the current best */
-      if (best_stream == NULL || best_payload->ts > payload->ts) {
-        best_stream = stream;
-        best_payload = payload;
-      }
-    }
-  }
+/* updates the moving average in @p_avg with the time passed since @start */
+void
+gst_asf_demux_update_avg_time (gint * p_avg, GstClockTime start)
+{
+  GstClockTimeDiff elapsed;
+  gint avg;
+
+  elapsed = MIN (GST_CLOCK_DIFF (start, gst_util_get_timestamp ()),
+      G_MAXINT);
+  avg = g_atomic_int_get (p_avg);
+  g_atomic_int_set (p_avg, avg + (gint) ((elapsed - avg) / 16));
+}
+
+/* pushes the buffers collected for @stream so far, if any */
+static GstFlowReturn
+gst_asf_demux_push_buffer_list (GstASFDemux * demux, AsfStream * stream,
+    GstBufferList ** p_list)
+{
+  GstBufferList *list = *p_list;
+  GstClockTime start;
+  GstFlowReturn ret;
+
+  if (list == NULL)
+    return GST_FLOW_OK;
 
-  return best_stream;
+  *p_list = NULL;
+
+  GST_LOG_OBJECT (stream->pad, "pushing list of %u buffers",
+      gst_buffer_list_length (list));
+
+  start = gst_util_get_timestamp ();
+  ret = gst_pad_push_list (stream->pad, list);
+  gst_asf_demux_update_avg_time (&demux->stat_push_time, start);
+  return gst_flow_combiner_update_pad_flow (demux->flowcombiner, stream->pad,
+      ret);
 }
 
 static GstFlowReturn
 gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
 {
   AsfStream *stream;
+  AsfStream *list_stream = NULL;
+  GstBufferList *list = NULL;
+  gboolean use_list;
   GstFlowReturn ret = GST_FLOW_OK;
+  GstFlowReturn list_ret;
 
   if (G_UNLIKELY (!demux->activated_streams)) {
     if (!gst_asf_demux_check_activate_streams (demux, force))
@@ -1720,15 +2481,29 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
     /* streams are now activated */
   }
 
+  GST_OBJECT_LOCK (demux);
+  use_list = demux->buffer_list;
+  GST_OBJECT_UNLOCK (demux);
+
   while ((stream = gst_asf_demux_find_stream_with_complete_payload (demux))) {
     AsfPayload *payload;
     GstClockTime timestamp = GST_CLOCK_TIME_NONE;
     GstClockTime duration = GST_CLOCK_TIME_NONE;
+    gboolean par_changed, interlace_changed;
 
     /* wait until we had a chance to "lock on" some payload's timestamp */
     if (G_UNLIKELY (demux->need_newsegment
             && !GST_CLOCK_TIME_IS_VALID (demux->segment_ts)))
-      return GST_FLOW_OK;
+      break;
+
+    /* buffers collected for another stream, or anything we are going to
+     * send events for, must go out first to keep the dataflow ordered */
+    if (list != NULL && (list_stream != stream || demux->need_newsegment
+            || stream->pending_tags)) {
+      ret = gst_asf_demux_push_buffer_list (demux, list_stream, &list);
+      if (G_UNLIKELY (ret != GST_FLOW_OK))
+        break;
+    }
 
     if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) && stream->is_video
         && stream->payloads->len) {
@@ -1737,6 +2512,26 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       payload = &g_array_index (stream->payloads, AsfPayload, 0);
     }
 
+    /* without buffer-list, only the sub-payloads of compressed payloads are
+     * collected (they are tiny and come in bursts), anything else goes out
+     * on its own */
+    if (list != NULL && !use_list && !payload->sub_payload) {
+      ret = gst_asf_demux_push_buffer_list (demux, list_stream, &list);
+      if (G_UNLIKELY (ret != GST_FLOW_OK))
+        break;
+    }
+
+    par_changed = stream->is_video && payload->par_x && payload->par_y &&
+        (payload->par_x != stream->par_x) && (payload->par_y != stream->par_y);
+    interlace_changed = stream->interlaced != payload->interlaced;
+
+    /* the buffers collected so far must go out with the old caps */
+    if (list != NULL && (par_changed || interlace_changed)) {
+      ret = gst_asf_demux_push_buffer_list (demux, list_stream, &list);
+      if (G_UNLIKELY (ret != GST_FLOW_OK))
+        break;
+    }
+
     /* do we need to send a newsegment event */
     if ((G_UNLIKELY (demux->need_newsegment))) {
       GstEvent *segment_event;
@@ -1759,6 +2554,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
             GST_TIME_ARGS (payload->ts));
         demux->segment.start = payload->ts;
         demux->segment.time = payload->ts;
+        gst_asf_demux_sched_invalidate (demux);
       }
 
       GST_DEBUG_OBJECT (demux, "sending new-segment event %" GST_SEGMENT_FORMAT,
@@ -1816,9 +2612,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       stream->discont = FALSE;
     }
 
-    if (G_UNLIKELY (stream->is_video && payload->par_x && payload->par_y &&
-            (payload->par_x != stream->par_x) &&
-            (payload->par_y != stream->par_y))) {
+    if (G_UNLIKELY (par_changed)) {
       GST_DEBUG ("Updating PAR (%d/%d => %d/%d)",
           stream->par_x, stream->par_y, payload->par_x, payload->par_y);
       stream->par_x = payload->par_x;
@@ -1829,7 +2623,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       gst_pad_set_caps (stream->pad, stream->caps);
     }
 
-    if (G_UNLIKELY (stream->interlaced != payload->interlaced)) {
+    if (G_UNLIKELY (interlace_changed)) {
       GST_DEBUG ("Updating interlaced status (%d => %d)", stream->interlaced,
           payload->interlaced);
       stream->interlaced = payload->interlaced;
@@ -1854,12 +2648,17 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
         GST_DEBUG_OBJECT (stream->pad,
             "Payload after segment stop %" GST_TIME_FORMAT,
             GST_TIME_ARGS (demux->segment.stop));
-        ret =
-            gst_flow_combiner_update_pad_flow (demux->flowcombiner, stream->pad,
-            GST_FLOW_EOS);
+        if (list != NULL)
+          ret = gst_asf_demux_push_buffer_list (demux, list_stream, &list);
+        if (ret == GST_FLOW_OK)
+          ret =
+              gst_flow_combiner_update_pad_flow (demux->flowcombiner,
+              stream->pad, GST_FLOW_EOS);
         gst_buffer_unref (payload->buf);
         payload->buf = NULL;
         g_array_remove_index (stream->payloads, 0);
+        stream->payloads_idx_valid = FALSE;
+        stream->sched_dirty = TRUE;
         /* Break out as soon as we have an issue */
         if (G_UNLIKELY (ret != GST_FLOW_OK))
           break;
@@ -1909,10 +2708,22 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
           demux->segment.position += timestamp;
       }
 
-      ret = gst_pad_push (stream->pad, payload->buf);
-      ret =
-          gst_flow_combiner_update_pad_flow (demux->flowcombiner, stream->pad,
-          ret);
+      if (use_list || payload->sub_payload) {
+        if (list == NULL) {
+          list = gst_buffer_list_new ();
+          list_stream = stream;
+        }
+        gst_buffer_list_add (list, payload->buf);
+        ret = GST_FLOW_OK;
+      } else {
+        GstClockTime start = gst_util_get_timestamp ();
+
+        ret = gst_pad_push (stream->pad, payload->buf);
+        gst_asf_demux_update_avg_time (&demux->stat_push_time, start);
+        ret =
+            gst_flow_combiner_update_pad_flow (demux->flowcombiner,
+            stream->pad, ret);
+      }
     } else {
       gst_buffer_unref (payload->buf);
       ret = GST_FLOW_OK;
@@ -1930,12 +2741,18 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
     } else {
       g_array_remove_index (stream->payloads, 0);
     }
+    stream->payloads_idx_valid = FALSE;
+    stream->sched_dirty = TRUE;
 
     /* Break out as soon as we have an issue */
     if (G_UNLIKELY (ret != GST_FLOW_OK))
       break;
   }
 
+  list_ret = gst_asf_demux_push_buffer_list (demux, list_stream, &list);
+  if (ret == GST_FLOW_OK)
+    ret = list_ret;
+
   return ret;
 }
 
@@ -2054,6 +2871,7 @@ gst_asf_demux_loop (GstASFDemux * demux)
 
       GST_INFO_OBJECT (demux, "Ignoring recoverable parse error");
       gst_buffer_unref (buf);
+      demux->lidx_last = -1;
 
       if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)
           && !demux->seek_to_cur_pos) {
@@ -2248,6 +3066,52 @@ gst_asf_demux_check_header (GstASFDemux * demux)
   return GST_ASF_DEMUX_CHECK_HEADER_NO;
 }
 
+/* parses the index objects following the data object when streaming, so
+ * later seeks can use them. Returns EOS once there is anything else. */
+static GstFlowReturn
+gst_asf_demux_chain_indices (GstASFDemux * demux)
+{
+  const guint8 *cdata;
+  AsfObject obj;
+
+  while ((cdata = gst_adapter_map (demux->adapter, ASF_OBJECT_HEADER_SIZE))) {
+    GstFlowReturn ret;
+    guint8 *data;
+    guint64 size;
+    gboolean valid;
+
+    valid = asf_demux_peek_object (demux, cdata, ASF_OBJECT_HEADER_SIZE, &obj,
+        FALSE);
+    gst_adapter_unmap (demux->adapter);
+
+    if (!valid || (obj.id != ASF_OBJ_SIMPLE_INDEX && obj.id != ASF_OBJ_INDEX))
+      return GST_FLOW_EOS;
+
+    /* check for sanity */
+    if (G_UNLIKELY (obj.size < ASF_OBJECT_HEADER_SIZE ||
+            obj.size > (5 * 1024 * 1024))) {
+      GST_DEBUG_OBJECT (demux, "implausible index object size, ignoring");
+      return GST_FLOW_EOS;
+    }
+
+    if (gst_adapter_available (demux->adapter) < obj.size)
+      return GST_FLOW_OK;
+
+    data = (guint8 *) gst_adapter_map (demux->adapter, obj.size);
+    size = obj.size;
+    ret = gst_asf_demux_process_object (demux, &data, &size);
+    gst_adapter_unmap (demux->adapter);
+    gst_adapter_flush (demux->adapter, obj.size);
+
+    if (G_UNLIKELY (ret != GST_FLOW_OK)) {
+      GST_DEBUG_OBJECT (demux, "corrupted index, ignoring");
+      return GST_FLOW_EOS;
+    }
+  }
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
@@ -2275,6 +3139,8 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   }
 
   gst_adapter_push (demux->adapter, buf);
+  g_atomic_int_set (&demux->stat_adapter_bytes,
+      gst_adapter_available (demux->adapter));
 
   switch (demux->state) {
     case GST_ASF_DEMUX_STATE_INDEX:{
@@ -2283,11 +3149,13 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
         break;
 
       if (result == GST_ASF_DEMUX_CHECK_HEADER_NO) {
-        /* we don't care about this, probably an index */
-        /* TODO maybe would be smarter to skip all the indices
-         * until we got a new header or EOS to decide */
-        GST_LOG_OBJECT (demux, "Received index object, its EOS");
-        goto eos;
+        /* probably an index, which we keep for seeking */
+        ret = gst_asf_demux_chain_indices (demux);
+        if (ret == GST_FLOW_EOS) {
+          GST_LOG_OBJECT (demux, "Received all index objects, its EOS");
+          goto eos;
+        }
+        break;
       } else {
         GST_INFO_OBJECT (demux, "Chained asf starting");
         /* cleanup and get ready for a chained asf */
@@ -2338,8 +3206,10 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
 
         if (G_LIKELY (err == GST_ASF_DEMUX_PARSE_PACKET_ERROR_NONE))
           ret = gst_asf_demux_push_complete_payloads (demux, FALSE);
-        else
+        else {
           GST_WARNING_OBJECT (demux, "Parse error");
+          demux->lidx_last = -1;
+        }
 
         if (demux->packet >= 0)
           ++demux->packet;
@@ -2355,6 +3225,9 @@ gst_asf_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
   }
 
 done:
+  g_atomic_int_set (&demux->stat_adapter_bytes,
+      gst_adapter_available (demux->adapter));
+
   if (ret != GST_FLOW_OK)
     GST_DEBUG_OBJECT (demux, "flow: %s", gst_flow_get_name (ret));
 
@@ -2640,6 +3513,14 @@ gst_asf_demux_setup_pad (GstASFDemux * demux, GstPad * src_pad,
   /* TODO: create this array during reverse play? */
   stream->payloads_rev = g_array_new (FALSE, FALSE, sizeof (AsfPayload));
 
+  stream->payloads_idx = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+      g_free, NULL);
+  stream->payloads_rev_idx = g_hash_table_new_full (g_int64_hash,
+      g_int64_equal, g_free, NULL);
+  stream->payloads_idx_valid = FALSE;
+
+  stream->sched_pos = -1;
+
   GST_INFO ("Created pad %s for stream %u with caps %" GST_PTR_FORMAT,
       GST_PAD_NAME (src_pad), demux->num_streams, caps);
 
@@ -2912,48 +3793,222 @@ gst_asf_demux_add_video_stream (GstASFDemux * demux,
           mv_mode = GST_VIDEO_MULTIVIEW_MODE_LEFT;
         break;
       }
-      default:
-        break;
+      default:
+        break;
+    }
+
+    GST_INFO_OBJECT (demux,
+        "stream_id %d, has multiview-mode %d flags 0x%x", id, mv_mode,
+        (guint) mv_flags);
+
+    mview_mode_str = gst_video_multiview_mode_to_caps_string (mv_mode);
+    if (mview_mode_str != NULL) {
+      if (gst_video_multiview_guess_half_aspect (mv_mode, video->width,
+              video->height, par_w, par_h))
+        mv_flags |= GST_VIDEO_MULTIVIEW_FLAGS_HALF_ASPECT;
+
+      gst_caps_set_simple (caps,
+          "multiview-mode", G_TYPE_STRING, mview_mode_str,
+          "multiview-flags", GST_TYPE_VIDEO_MULTIVIEW_FLAGSET, mv_flags,
+          GST_FLAG_SET_MASK_EXACT, NULL);
+    }
+  }
+
+  if (codec_name) {
+    tags = gst_tag_list_new (GST_TAG_VIDEO_CODEC, codec_name, NULL);
+    g_free (codec_name);
+  }
+
+  if (extradata)
+    gst_buffer_unref (extradata);
+
+  GST_INFO ("Adding video stream #%u, id %u, codec %"
+      GST_FOURCC_FORMAT " (0x%08x)", demux->num_video_streams, id,
+      GST_FOURCC_ARGS (video->tag), video->tag);
+
+  ++demux->num_video_streams;
+
+  return gst_asf_demux_setup_pad (demux, src_pad, caps, id, TRUE,
+      streamheader, tags);
+}
+
+static GstBufferPool *
+gst_asf_demux_create_pool (GstASFDemux * demux, guint size)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, NULL, size, 0,
+      GST_ASF_DEMUX_POOL_MAX_BUFFERS);
+
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_WARNING_OBJECT (demux, "failed to set up pool for %u bytes", size);
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (demux, "created pool for buffers of %u bytes", size);
+  return pool;
+}
+
+static GstBuffer *
+gst_asf_demux_acquire_buffer (GstBufferPool * pool, gsize size)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstBuffer *buf = NULL;
+
+  /* rather allocate than wait for downstream to release a buffer */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  if (gst_buffer_pool_acquire_buffer (pool, &buf, &params) != GST_FLOW_OK)
+    return NULL;
+
+  /* the pool restores the full size when the buffer is released */
+  gst_buffer_set_size (buf, size);
+  return buf;
+}
+
+/* returns a buffer of @size bytes, from the pool downstream gave us for
+ * @stream if it's big enough, or otherwise from a pool for the next power of
+ * two, so the memory is reused once downstream is done with the buffer */
+GstBuffer *
+gst_asf_demux_alloc_buffer (GstASFDemux * demux, AsfStream * stream,
+    gsize size)
+{
+  GstBuffer *buf;
+  guint shift, n;
+
+  if (stream != NULL && stream->pool != NULL && size <= stream->pool_size) {
+    buf = gst_asf_demux_acquire_buffer (stream->pool, size);
+    if (buf != NULL) {
+      g_atomic_int_inc (&demux->stat_buffers_downstream);
+      return buf;
+    }
+  }
+
+  shift = (size > 1) ? g_bit_storage (size - 1) : 0;
+  shift = MAX (shift, GST_ASF_DEMUX_POOL_MIN_SHIFT);
+  n = shift - GST_ASF_DEMUX_POOL_MIN_SHIFT;
+
+  if (n < GST_ASF_DEMUX_NUM_POOLS) {
+    if (G_UNLIKELY (demux->pools[n] == NULL))
+      demux->pools[n] = gst_asf_demux_create_pool (demux, 1 << shift);
+
+    if (demux->pools[n] != NULL) {
+      buf = gst_asf_demux_acquire_buffer (demux->pools[n], size);
+      if (buf != NULL) {
+        g_atomic_int_inc (&demux->stat_buffers_pooled);
+        return buf;
+      }
     }
+  }
 
-    GST_INFO_OBJECT (demux,
-        "stream_id %d, has multiview-mode %d flags 0x%x", id, mv_mode,
-        (guint) mv_flags);
+  g_atomic_int_inc (&demux->stat_buffers_allocated);
+  return gst_buffer_new_allocate (NULL, size, NULL);
+}
 
-    mview_mode_str = gst_video_multiview_mode_to_caps_string (mv_mode);
-    if (mview_mode_str != NULL) {
-      if (gst_video_multiview_guess_half_aspect (mv_mode, video->width,
-              video->height, par_w, par_h))
-        mv_flags |= GST_VIDEO_MULTIVIEW_FLAGS_HALF_ASPECT;
+static void
+gst_asf_demux_free_pools (GstASFDemux * demux)
+{
+  guint i;
 
-      gst_caps_set_simple (caps,
-          "multiview-mode", G_TYPE_STRING, mview_mode_str,
-          "multiview-flags", GST_TYPE_VIDEO_MULTIVIEW_FLAGSET, mv_flags,
-          GST_FLAG_SET_MASK_EXACT, NULL);
+  for (i = 0; i < GST_ASF_DEMUX_NUM_POOLS; ++i) {
+    if (demux->pools[i] != NULL) {
+      gst_buffer_pool_set_active (demux->pools[i], FALSE);
+      gst_object_unref (demux->pools[i]);
+      demux->pools[i] = NULL;
     }
   }
+}
 
-  if (codec_name) {
-    tags = gst_tag_list_new (GST_TAG_VIDEO_CODEC, codec_name, NULL);
-    g_free (codec_name);
+/* use the pool downstream proposes for buffers we have to allocate */
+static void
+gst_asf_demux_stream_query_allocation (GstASFDemux * demux,
+    AsfStream * stream)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstQuery *query;
+  guint size = 0, min = 0, max = 0;
+
+  query = gst_query_new_allocation (stream->caps, TRUE);
+  if (gst_pad_peer_query (stream->pad, query) &&
+      gst_query_get_n_allocation_pools (query) > 0)
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+  gst_query_unref (query);
+
+  if (pool == NULL || size == 0)
+    goto no_pool;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, stream->caps, size, min, max);
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE))
+    goto no_pool;
+
+  GST_DEBUG_OBJECT (stream->pad, "using downstream pool for buffers of up "
+      "to %u bytes", size);
+  stream->pool = pool;
+  stream->pool_size = size;
+  return;
+
+no_pool:
+  {
+    if (pool)
+      gst_object_unref (pool);
+    return;
   }
+}
 
-  if (extradata)
-    gst_buffer_unref (extradata);
+/* after a chained header, a stream that didn't change keeps the pad of the
+ * previous file, so downstream doesn't have to renegotiate or set up its
+ * decoder again, as happens with live streams sending a new header */
+static gboolean
+gst_asf_demux_take_old_pad (GstASFDemux * demux, AsfStream * stream)
+{
+  guint i;
 
-  GST_INFO ("Adding video stream #%u, id %u, codec %"
-      GST_FOURCC_FORMAT " (0x%08x)", demux->num_video_streams, id,
-      GST_FOURCC_ARGS (video->tag), video->tag);
+  for (i = 0; i < demux->old_num_streams; ++i) {
+    AsfStream *old = &demux->old_stream[i];
+    GstPad *pad;
 
-  ++demux->num_video_streams;
+    if (!old->active || old->id != stream->id
+        || old->is_video != stream->is_video)
+      continue;
 
-  return gst_asf_demux_setup_pad (demux, src_pad, caps, id, TRUE,
-      streamheader, tags);
+    if (!gst_caps_is_equal (old->caps, stream->caps))
+      return FALSE;
+
+    GST_INFO_OBJECT (demux, "Stream %2u unchanged, keeping pad %s",
+        stream->id, GST_PAD_NAME (old->pad));
+
+    /* the new pad, which was never added, is freed with the old stream */
+    pad = stream->pad;
+    stream->pad = old->pad;
+    old->pad = pad;
+    old->active = FALSE;
+
+    stream->pool = old->pool;
+    stream->pool_size = old->pool_size;
+    old->pool = NULL;
+    old->pool_size = 0;
+
+    return TRUE;
+  }
+
+  return FALSE;
 }
 
 static void
 gst_asf_demux_activate_stream (GstASFDemux * demux, AsfStream * stream)
 {
+  if (!stream->active && gst_asf_demux_take_old_pad (demux, stream)) {
+    stream->active = TRUE;
+    return;
+  }
+
   if (!stream->active) {
     GstEvent *event;
     gchar *stream_id;
@@ -2990,6 +4045,8 @@ gst_asf_demux_activate_stream (GstASFDemux * demux, AsfStream * stream)
     gst_element_add_pad (GST_ELEMENT_CAST (demux), stream->pad);
     gst_flow_combiner_add_pad (demux->flowcombiner, stream->pad);
     stream->active = TRUE;
+
+    gst_asf_demux_stream_query_allocation (demux, stream);
   }
 }
 
@@ -3720,6 +4777,149 @@ not_enough_data:
   }
 }
 
+static gboolean
+gst_asf_demux_probe_file (AsfHeaderInfo * info, guint8 * data, guint64 size)
+{
+  guint64 play_time, preroll;
+  guint32 flags, min_pktsize, max_pktsize;
+
+  if (size < (16 + 8 + 8 + 8 + 8 + 8 + 8 + 4 + 4 + 4 + 4))
+    return FALSE;
+
+  gst_asf_demux_get_guid (&info->file_guid, &data, &size);
+  gst_asf_demux_skip_bytes (8 + 8, &data, &size);       /* file size, date */
+  info->num_packets = gst_asf_demux_get_uint64 (&data, &size);
+  play_time = gst_asf_demux_get_uint64 (&data, &size);
+  gst_asf_demux_skip_bytes (8, &data, &size);   /* send duration */
+  preroll = gst_asf_demux_get_uint64 (&data, &size);
+  flags = gst_asf_demux_get_uint32 (&data, &size);
+  min_pktsize = gst_asf_demux_get_uint32 (&data, &size);
+  max_pktsize = gst_asf_demux_get_uint32 (&data, &size);
+  info->max_bitrate = gst_asf_demux_get_uint32 (&data, &size);
+
+  info->broadcast = ! !(flags & 0x01);
+  info->seekable = ! !(flags & 0x02);
+
+  /* same as in _process_file() */
+  if (min_pktsize != max_pktsize)
+    return FALSE;
+  info->packet_size = max_pktsize;
+
+  info->preroll = preroll * GST_MSECOND;
+  if (!info->broadcast && (play_time * 100) >= info->preroll)
+    info->duration = (play_time * 100) - info->preroll;
+  if (info->broadcast)
+    info->num_packets = 0;
+
+  return TRUE;
+}
+
+/* Extracts basic information about a file from its header object, without
+ * creating caps, tags or pads. This doesn't need a demuxer instance and may
+ * be called from any thread. @data must contain the whole header object; if
+ * it doesn't, but at least the object header could be read, the size needed
+ * is stored in info->header_size. Streams only declared inside the header
+ * extension object are not counted.
+ *
+ * Returns TRUE if @data starts with a valid header object of a file with
+ * fixed packet size. */
+gboolean
+gst_asf_demux_probe_header (const guint8 * data, gsize size,
+    AsfHeaderInfo * info)
+{
+  AsfObject obj;
+  guint32 num_objects, i;
+  gboolean saw_file_header = FALSE;
+  guint64 left;
+  guint8 *p;
+
+  g_return_val_if_fail (data != NULL, FALSE);
+  g_return_val_if_fail (info != NULL, FALSE);
+
+  memset (info, 0, sizeof (AsfHeaderInfo));
+
+  if (size < ASF_OBJECT_HEADER_SIZE)
+    return FALSE;
+
+  if (!asf_demux_peek_object (NULL, data, ASF_OBJECT_HEADER_SIZE, &obj, TRUE)
+      || obj.id != ASF_OBJ_HEADER)
+    return FALSE;
+
+  info->header_size = obj.size;
+  if (obj.size < ASF_OBJECT_HEADER_SIZE + 4 + 1 + 1 || obj.size > size)
+    return FALSE;
+
+  /* the readers only advance the pointer, they don't write to the data */
+  p = (guint8 *) data + ASF_OBJECT_HEADER_SIZE;
+  left = obj.size - ASF_OBJECT_HEADER_SIZE;
+
+  num_objects = gst_asf_demux_get_uint32 (&p, &left);
+  gst_asf_demux_skip_bytes (1 + 1, &p, &left);
+
+  for (i = 0; i < num_objects; ++i) {
+    guint8 *obj_data;
+    guint64 obj_size;
+
+    if (left < ASF_OBJECT_HEADER_SIZE ||
+        !asf_demux_peek_object (NULL, p, ASF_OBJECT_HEADER_SIZE, &obj, FALSE)
+        || obj.size < ASF_OBJECT_HEADER_SIZE || obj.size > left) {
+      GST_DEBUG ("corrupted header part %u", i);
+      return FALSE;
+    }
+
+    obj_data = p + ASF_OBJECT_HEADER_SIZE;
+    obj_size = obj.size - ASF_OBJECT_HEADER_SIZE;
+
+    switch (obj.id) {
+      case ASF_OBJ_FILE:
+        if (!gst_asf_demux_probe_file (info, obj_data, obj_size))
+          return FALSE;
+        saw_file_header = TRUE;
+        break;
+      case ASF_OBJ_STREAM:{
+        AsfStreamType stream_type = ASF_STREAM_UNDEFINED;
+        ASFGuid guid;
+
+        if (obj_size >= 16) {
+          gst_asf_demux_get_guid (&guid, &obj_data, &obj_size);
+          stream_type = gst_asf_demux_identify_guid (asf_stream_guids, &guid);
+        }
+
+        /* dvr-ms has audio stream declared in stream specific data */
+        if (stream_type == ASF_STREAM_EXT_EMBED_HEADER &&
+            obj_size >= (16 + 8 + 4 + 4 + 2 + 4 + 16)) {
+          gst_asf_demux_skip_bytes (16 + 8 + 4 + 4 + 2 + 4, &obj_data,
+              &obj_size);
+          gst_asf_demux_get_guid (&guid, &obj_data, &obj_size);
+          if (gst_asf_demux_identify_guid (asf_ext_stream_guids, &guid) ==
+              ASF_EXT_STREAM_AUDIO)
+            stream_type = ASF_STREAM_AUDIO;
+        }
+
+        if (stream_type == ASF_STREAM_AUDIO)
+          ++info->num_audio_streams;
+        else if (stream_type == ASF_STREAM_VIDEO)
+          ++info->num_video_streams;
+        else
+          ++info->num_other_streams;
+        break;
+      }
+      case ASF_OBJ_CONTENT_ENCRYPTION:
+      case ASF_OBJ_EXT_CONTENT_ENCRYPTION:
+      case ASF_OBJ_DIGITAL_SIGNATURE_OBJECT:
+      case ASF_OBJ_UNKNOWN_ENCRYPTION_OBJECT:
+        info->encrypted = TRUE;
+        break;
+      default:
+        break;
+    }
+
+    gst_asf_demux_skip_bytes (obj.size, &p, &left);
+  }
+
+  return saw_file_header;
+}
+
 static GstFlowReturn
 gst_asf_demux_process_file (GstASFDemux * demux, guint8 * data, guint64 size)
 {
@@ -3732,7 +4932,7 @@ gst_asf_demux_process_file (GstASFDemux * demux, guint8 * data, guint64 size)
   if (size < (16 + 8 + 8 + 8 + 8 + 8 + 8 + 4 + 4 + 4 + 4))
     goto not_enough_data;
 
-  gst_asf_demux_skip_bytes (16, &data, &size);  /* skip GUID */
+  gst_asf_demux_get_guid (&demux->file_guid, &data, &size);
   file_size = gst_asf_demux_get_uint64 (&data, &size);
   creation_time = gst_asf_demux_get_uint64 (&data, &size);
   packets_count = gst_asf_demux_get_uint64 (&data, &size);
@@ -3918,6 +5118,7 @@ gst_asf_demux_process_bitrate_props_object (GstASFDemux * demux, guint8 * data,
       GST_DEBUG_OBJECT (demux, "bitrate of stream %u = %u", stream_id, bitrate);
       stream = gst_asf_demux_get_stream (demux, stream_id);
       if (stream) {
+        stream->bitrate = bitrate;
         if (stream->pending_tags == NULL)
           stream->pending_tags = gst_tag_list_new_empty ();
         gst_tag_list_add (stream->pending_tags, GST_TAG_MERGE_REPLACE,
@@ -4080,12 +5281,137 @@ not_enough_data:
   }
 }
 
+static GstFlowReturn
+gst_asf_demux_process_index (GstASFDemux * demux, guint8 * data, guint64 size)
+{
+  GstClockTime interval;
+  GArray **entries = NULL;
+  guint16 *stream_nums = NULL;
+  guint16 *types = NULL;
+  guint64 *positions = NULL;
+  guint64 entry_num = 0;
+  guint32 num_blocks, b, i;
+  guint16 num_specs, s;
+
+  if (size < (4 + 2 + 4))
+    goto not_enough_data;
+
+  interval = gst_asf_demux_get_uint32 (&data, &size) * GST_MSECOND;
+  num_specs = gst_asf_demux_get_uint16 (&data, &size);
+  num_blocks = gst_asf_demux_get_uint32 (&data, &size);
+
+  GST_DEBUG_OBJECT (demux, "index object: interval %" GST_TIME_FORMAT
+      ", %u specifiers, %u blocks", GST_TIME_ARGS (interval), num_specs,
+      num_blocks);
+
+  if (interval == 0 || num_specs == 0 || demux->packet_size == 0)
+    return GST_FLOW_OK;
+
+  if (size < (guint64) num_specs * (2 + 2))
+    goto not_enough_data;
+
+  stream_nums = g_new (guint16, num_specs);
+  types = g_new (guint16, num_specs);
+  positions = g_new (guint64, num_specs);
+  entries = g_new (GArray *, num_specs);
+
+  for (s = 0; s < num_specs; ++s) {
+    stream_nums[s] = gst_asf_demux_get_uint16 (&data, &size);
+    types[s] = gst_asf_demux_get_uint16 (&data, &size);
+    entries[s] = g_array_new (FALSE, FALSE, sizeof (AsfIndexEntry));
+    GST_LOG_OBJECT (demux, "specifier %u: stream %u, type %u", s,
+        stream_nums[s], types[s]);
+  }
+
+  for (b = 0; b < num_blocks; ++b) {
+    guint32 num_entries;
+
+    if (size < 4 + (guint64) num_specs * 8) {
+      GST_WARNING_OBJECT (demux, "index object truncated at block %u", b);
+      break;
+    }
+
+    num_entries = gst_asf_demux_get_uint32 (&data, &size);
+    for (s = 0; s < num_specs; ++s)
+      positions[s] = gst_asf_demux_get_uint64 (&data, &size);
+
+    if (size < (guint64) num_entries * num_specs * 4) {
+      GST_WARNING_OBJECT (demux, "index block %u truncated", b);
+      num_entries = size / (num_specs * 4);
+    }
+
+    for (i = 0; i < num_entries; ++i, ++entry_num) {
+      for (s = 0; s < num_specs; ++s) {
+        AsfIndexEntry entry;
+        guint32 offset;
+
+        offset = gst_asf_demux_get_uint32 (&data, &size);
+        if (offset == G_MAXUINT32)
+          continue;
+
+        /* offsets are relative to the block position, which is relative to
+         * the first data packet */
+        entry.packet = (positions[s] + offset) / demux->packet_size;
+        entry.ts = entry_num * interval;
+
+        if (demux->num_packets > 0 && entry.packet >= demux->num_packets)
+          continue;
+
+        /* entries point at the packet with the data (or cleanpoint) at or
+         * before their time, so the first entry for each packet is the
+         * closest to it; the others don't add anything */
+        if (entries[s]->len > 0 && g_array_index (entries[s], AsfIndexEntry,
+                entries[s]->len - 1).packet == entry.packet)
+          continue;
+
+        g_array_append_val (entries[s], entry);
+      }
+    }
+  }
+
+  /* a stream may be indexed more than once, keep the most useful index,
+   * ie. the one with the highest type (cleanpoints > objects > packets) */
+  for (s = 0; s < num_specs; ++s) {
+    AsfStream *stream;
+
+    stream = gst_asf_demux_get_stream (demux, stream_nums[s]);
+    if (stream == NULL || entries[s]->len == 0 ||
+        (stream->idx_entries != NULL && stream->idx_type >= types[s])) {
+      g_array_free (entries[s], TRUE);
+      continue;
+    }
+
+    GST_DEBUG_OBJECT (demux, "stream %u: %u index entries of type %u",
+        stream->id, entries[s]->len, types[s]);
+
+    g_free (stream->idx_entries);
+    stream->idx_num_entries = entries[s]->len;
+    stream->idx_entries = (AsfIndexEntry *) g_array_free (entries[s], FALSE);
+    stream->idx_type = types[s];
+    demux->stream_index = TRUE;
+  }
+
+  g_free (entries);
+  g_free (positions);
+  g_free (types);
+  g_free (stream_nums);
+
+  return GST_FLOW_OK;
+
+not_enough_data:
+  {
+    GST_WARNING_OBJECT (demux, "short read parsing index object!");
+    return GST_FLOW_OK;         /* not fatal */
+  }
+}
+
 static GstFlowReturn
 gst_asf_demux_process_advanced_mutual_exclusion (GstASFDemux * demux,
     guint8 * data, guint64 size)
 {
   ASFGuid guid;
   guint16 num, i;
+  guint8 mbr_group = 0;
 
   if (size < 16 + 2 + (2 * 2))
     goto not_enough_data;
@@ -4101,6 +5427,12 @@ gst_asf_demux_process_advanced_mutual_exclusion (GstASFDemux * demux,
   if (size < (num * sizeof (guint16)))
     goto not_enough_data;
 
+  /* remember streams that are variants of the same content at different
+   * bitrates, so we can pick one of them later */
+  if (gst_asf_demux_identify_guid (asf_mutex_guids, &guid) == ASF_MUTEX_BITRATE
+      && demux->num_mbr_groups < G_MAXUINT8)
+    mbr_group = ++demux->num_mbr_groups;
+
   /* read mutually exclusive stream numbers */
   for (i = 0; i < num; ++i) {
     guint8 mes;
@@ -4109,6 +5441,7 @@ gst_asf_demux_process_advanced_mutual_exclusion (GstASFDemux * demux,
 
     demux->mut_ex_streams =
         g_slist_append (demux->mut_ex_streams, GINT_TO_POINTER (mes));
+    demux->mbr_group[mes] = mbr_group;
   }
 
 
@@ -4527,6 +5860,9 @@ gst_asf_demux_process_object (GstASFDemux * demux, guint8 ** p_data,
     case ASF_OBJ_SIMPLE_INDEX:
       ret = gst_asf_demux_process_simple_index (demux, *p_data, obj_data_size);
       break;
+    case ASF_OBJ_INDEX:
+      ret = gst_asf_demux_process_index (demux, *p_data, obj_data_size);
+      break;
     case ASF_OBJ_CONTENT_ENCRYPTION:
     case ASF_OBJ_EXT_CONTENT_ENCRYPTION:
     case ASF_OBJ_DIGITAL_SIGNATURE_OBJECT:
@@ -4536,7 +5872,6 @@ gst_asf_demux_process_object (GstASFDemux * demux, guint8 ** p_data,
     case ASF_OBJ_HEAD2:
     case ASF_OBJ_UNDEFINED:
     case ASF_OBJ_CODEC_COMMENT:
-    case ASF_OBJ_INDEX:
     case ASF_OBJ_PADDING:
     case ASF_OBJ_BITRATE_MUTEX:
     case ASF_OBJ_COMPATIBILITY:
@@ -4569,50 +5904,96 @@ error_encrypted:
   }
 }
 
+/* the chunk order only depends on the descrambling parameters of the stream
+ * and the payload size, so compute it once and keep it around */
+static gboolean
+gst_asf_demux_descramble_update_perm (AsfStream * stream, guint num_chunks)
+{
+  guint off;
+
+  if (stream->ds_perm != NULL && stream->ds_perm_len == num_chunks &&
+      stream->ds_perm_span == stream->span &&
+      stream->ds_perm_packet_size == stream->ds_packet_size &&
+      stream->ds_perm_chunk_size == stream->ds_chunk_size)
+    return TRUE;
+
+  g_free (stream->ds_perm);
+  stream->ds_perm = g_new (guint, num_chunks);
+  stream->ds_perm_len = num_chunks;
+  stream->ds_perm_span = stream->span;
+  stream->ds_perm_packet_size = stream->ds_packet_size;
+  stream->ds_perm_chunk_size = stream->ds_chunk_size;
+
+  for (off = 0; off < num_chunks; ++off) {
+    guint row = off / stream->span;
+    guint col = off % stream->span;
+    /* the packet size needn't be a multiple of the chunk size, so scale the
+     * whole packet offset rather than counting whole chunks per packet */
+    guint idx = row + (col * stream->ds_packet_size) / stream->ds_chunk_size;
+
+    if (G_UNLIKELY (idx >= num_chunks)) {
+      GST_WARNING ("can't descramble %u chunks with span %u, packet size %u "
+          "and chunk size %u", num_chunks, stream->span,
+          stream->ds_packet_size, stream->ds_chunk_size);
+      g_free (stream->ds_perm);
+      stream->ds_perm = NULL;
+      stream->ds_perm_len = 0;
+      return FALSE;
+    }
+    stream->ds_perm[off] = idx;
+  }
+
+  GST_DEBUG ("descrambling table for %u chunks of %u bytes, span=%u, "
+      "packet_size=%u", num_chunks, stream->ds_chunk_size, stream->span,
+      stream->ds_packet_size);
+
+  return TRUE;
+}
+
 static void
 gst_asf_demux_descramble_buffer (GstASFDemux * demux, AsfStream * stream,
     GstBuffer ** p_buffer)
 {
   GstBuffer *descrambled_buffer;
   GstBuffer *scrambled_buffer;
-  GstBuffer *sub_buffer;
-  guint offset;
+  GstMapInfo in_map, out_map;
+  guint chunk_size;
+  guint num_chunks;
   guint off;
-  guint row;
-  guint col;
-  guint idx;
+  gsize size;
 
-  /* descrambled_buffer is initialised in the first iteration */
-  descrambled_buffer = NULL;
   scrambled_buffer = *p_buffer;
+  size = gst_buffer_get_size (scrambled_buffer);
+  chunk_size = stream->ds_chunk_size;
 
-  if (gst_buffer_get_size (scrambled_buffer) <
-      stream->ds_packet_size * stream->span)
+  if (size < stream->ds_packet_size * stream->span)
     return;
 
-  for (offset = 0; offset < gst_buffer_get_size (scrambled_buffer);
-      offset += stream->ds_chunk_size) {
-    off = offset / stream->ds_chunk_size;
-    row = off / stream->span;
-    col = off % stream->span;
-    idx = row + col * stream->ds_packet_size / stream->ds_chunk_size;
-    GST_DEBUG ("idx=%u, row=%u, col=%u, off=%u, ds_chunk_size=%u", idx, row,
-        col, off, stream->ds_chunk_size);
-    GST_DEBUG ("scrambled buffer size=%" G_GSIZE_FORMAT
-        ", span=%u, packet_size=%u", gst_buffer_get_size (scrambled_buffer),
-        stream->span, stream->ds_packet_size);
-    GST_DEBUG ("gst_buffer_get_size (scrambled_buffer) = %" G_GSIZE_FORMAT,
-        gst_buffer_get_size (scrambled_buffer));
-    sub_buffer =
-        gst_buffer_copy_region (scrambled_buffer, GST_BUFFER_COPY_MEMORY,
-        idx * stream->ds_chunk_size, stream->ds_chunk_size);
-    if (!offset) {
-      descrambled_buffer = sub_buffer;
-    } else {
-      descrambled_buffer = gst_buffer_append (descrambled_buffer, sub_buffer);
-    }
+  if (G_UNLIKELY (chunk_size == 0 || size % chunk_size != 0)) {
+    GST_WARNING_OBJECT (demux, "payload size %" G_GSIZE_FORMAT " is not a "
+        "multiple of the chunk size %u, not descrambling", size, chunk_size);
+    return;
+  }
+
+  num_chunks = size / chunk_size;
+  if (!gst_asf_demux_descramble_update_perm (stream, num_chunks))
+    return;
+
+  /* copy all chunks into one new buffer instead of appending each of them
+   * as a separate memory */
+  descrambled_buffer = gst_asf_demux_alloc_buffer (demux, stream, size);
+
+  gst_buffer_map (scrambled_buffer, &in_map, GST_MAP_READ);
+  gst_buffer_map (descrambled_buffer, &out_map, GST_MAP_WRITE);
+
+  for (off = 0; off < num_chunks; ++off) {
+    memcpy (out_map.data + off * chunk_size,
+        in_map.data + stream->ds_perm[off] * chunk_size, chunk_size);
   }
 
+  gst_buffer_unmap (descrambled_buffer, &out_map);
+  gst_buffer_unmap (scrambled_buffer, &in_map);
+
   GST_BUFFER_TIMESTAMP (descrambled_buffer) =
       GST_BUFFER_TIMESTAMP (scrambled_buffer);
   GST_BUFFER_DURATION (descrambled_buffer) =
@@ -4842,6 +6223,118 @@ gst_asf_demux_handle_src_query (GstPad * pad, GstObject * parent,
   return res;
 }
 
+static GstStructure *
+gst_asf_demux_get_stats (GstASFDemux * demux)
+{
+  GValue depths = G_VALUE_INIT;
+  GValue depth = G_VALUE_INIT;
+  GstStructure *s;
+  guint i, num_streams;
+
+  g_value_init (&depths, GST_TYPE_ARRAY);
+  g_value_init (&depth, G_TYPE_UINT);
+
+  /* the streams array is never freed, so at worst we report a stream that
+   * is just being added or removed */
+  num_streams = MIN (demux->num_streams, GST_ASF_DEMUX_NUM_STREAMS);
+  for (i = 0; i < num_streams; ++i) {
+    g_value_set_uint (&depth, g_atomic_int_get (&demux->stream[i].stat_queued));
+    gst_value_array_append_value (&depths, &depth);
+  }
+  g_value_unset (&depth);
+
+  s = gst_structure_new ("application/x-asfdemux-stats",
+      "buffers-allocated", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&demux->stat_buffers_allocated),
+      "buffers-pooled", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&demux->stat_buffers_pooled),
+      "buffers-downstream", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&demux->stat_buffers_downstream),
+      "packets-parsed", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&demux->stat_packets_parsed),
+      "parse-errors", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&demux->stat_parse_errors),
+      "adapter-bytes", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&demux->stat_adapter_bytes),
+      "parse-time", G_TYPE_UINT64,
+      (guint64) g_atomic_int_get (&demux->stat_parse_time),
+      "push-time", G_TYPE_UINT64,
+      (guint64) g_atomic_int_get (&demux->stat_push_time), NULL);
+  gst_structure_take_value (s, "queue-depths", &depths);
+
+  return s;
+}
+
+static void
+gst_asf_demux_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstASFDemux *demux = GST_ASF_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_BUFFER_LIST:
+      GST_OBJECT_LOCK (demux);
+      demux->buffer_list = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_INDEX_CACHE_DIR:
+      GST_OBJECT_LOCK (demux);
+      g_free (demux->index_cache_dir);
+      demux->index_cache_dir = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_READ_AHEAD:
+      GST_OBJECT_LOCK (demux);
+      demux->read_ahead = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_BITRATE:
+      GST_OBJECT_LOCK (demux);
+      demux->max_bitrate = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_asf_demux_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstASFDemux *demux = GST_ASF_DEMUX (object);
+
+  switch (prop_id) {
+    case PROP_BUFFER_LIST:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->buffer_list);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_INDEX_CACHE_DIR:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_string (value, demux->index_cache_dir);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_READ_AHEAD:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->read_ahead);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_MAX_BITRATE:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_uint (value, demux->max_bitrate);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_asf_demux_get_stats (demux));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_asf_demux_finalize (GObject * object)
 {
@@ -4855,6 +6348,12 @@ gst_asf_demux_finalize (GObject * object)
     gst_structure_free (demux->global_metadata);
   demux->global_metadata = NULL;
 
+  g_array_free (demux->lidx, TRUE);
+  demux->lidx = NULL;
+
+  g_free (demux->index_cache_dir);
+  demux->index_cache_dir = NULL;
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -26,6 +26,7 @@
 #include <gst/base/gstflowcombiner.h>
 
 #include "asfheaders.h"
+#include "asfindex.h"
 
 G_BEGIN_DECLS
 
@@ -124,6 +125,11 @@ typedef struct
   guint16              ds_packet_size;
   guint16              ds_chunk_size;
   guint16              ds_data_size;
+  guint               *ds_perm;      /* source chunk for each output chunk */
+  guint                ds_perm_len;  /* number of chunks ds_perm is for    */
+  guint8               ds_perm_span; /* settings ds_perm was computed for  */
+  guint16              ds_perm_packet_size;
+  guint16              ds_perm_chunk_size;
 
   /* for new parsing code */
   GArray         *payloads;  /* pending payloads */
@@ -138,6 +144,32 @@ typedef struct
   GArray	*payloads_rev; /* Temp queue for storing multiple payloads of packet*/
   gint		kf_pos; /* KF position in payload queue. Payloads from this pos will be pushed */
 
+  /* (mo_number, mo_size) => position + 1 in the payload queues, so fragments
+   * can be matched up without scanning the queues in reverse playback */
+  GHashTable	*payloads_idx;
+  GHashTable	*payloads_rev_idx;
+  gboolean	payloads_idx_valid; /* FALSE after payloads got removed */
+
+  /* scheduling of complete payloads for pushing */
+  gboolean	sched_dirty;  /* payload queue changed since last evaluation */
+  gint		sched_pos;    /* position in demux->sched_heap, or -1 */
+  GstClockTime	sched_ts;     /* timestamp of the next payload to push */
+
+  /* from the index object, if the file has one; sorted by time and with
+   * one entry per packet only */
+  AsfIndexEntry	*idx_entries;
+  guint		idx_num_entries;
+  guint16	idx_type;     /* 1: data packet, 2: media object, 3: cleanpoint */
+
+  /* pool proposed by downstream, if any, and the size of its buffers */
+  GstBufferPool	*pool;
+  guint		pool_size;
+
+  gint		stat_queued;  /* payloads queued after the last packet, atomic */
+
+  guint32	bitrate;      /* from the bitrate properties object, or 0 */
+  gboolean	pruned;       /* unused bitrate variant, payloads are skipped */
+
   /* extended stream properties (optional) */
   AsfStreamExtProps  ext_props;
 
@@ -157,6 +189,12 @@ typedef enum {
 #define GST_ASF_DEMUX_NUM_STREAMS      32
 #define GST_ASF_DEMUX_NUM_STREAM_IDS  127
 
+/* buffer pools for sizes from 1 KiB to 1 MiB, by powers of two, with at
+ * most GST_ASF_DEMUX_POOL_MAX_BUFFERS buffers each */
+#define GST_ASF_DEMUX_POOL_MIN_SHIFT   10
+#define GST_ASF_DEMUX_NUM_POOLS        11
+#define GST_ASF_DEMUX_POOL_MAX_BUFFERS 16
+
 struct _GstASFDemux {
   GstElement 	     element;
 
@@ -188,6 +226,9 @@ struct _GstASFDemux {
   GstStructure	      *global_metadata;  /* metadata which isn't specific to one stream */
   GSList              *ext_stream_props; /* for delayed processing (buffers) */
   GSList              *mut_ex_streams;   /* mutually exclusive streams */
+  /* stream number => bitrate mutual exclusion group + 1, or 0 */
+  guint8               mbr_group[GST_ASF_DEMUX_NUM_STREAM_IDS + 1];
+  guint                num_mbr_groups;
 
   guint32              num_audio_streams;
   guint32              num_video_streams;
@@ -196,6 +237,10 @@ struct _GstASFDemux {
   gboolean             activated_streams;
   GstFlowCombiner     *flowcombiner;
 
+  /* streams with a complete payload, min-heap ordered by payload timestamp */
+  AsfStream           *sched_heap[GST_ASF_DEMUX_NUM_STREAMS];
+  guint                sched_heap_len;
+
   /* for chained asf handling, we need to hold the old asf streams until
    * we detect the new ones */
   AsfStream            old_stream[GST_ASF_DEMUX_NUM_STREAMS];
@@ -232,6 +277,17 @@ struct _GstASFDemux {
   guint                sidx_num_entries; /* number of index entries        */
   AsfSimpleIndexEntry *sidx_entries;     /* packet number for each entry   */
 
+  gboolean             stream_index;     /* streams have an index object index */
+
+  /* index learned during playback, used if there is no simple index */
+  GArray              *lidx;             /* AsfLearnedIndexEntry, sorted by ts */
+  gint                 lidx_last;        /* entry seen last in continuous
+                                          * playback, or -1                    */
+  guint16              lidx_stream;      /* stream the index is learned from   */
+  gboolean             lidx_dirty;       /* changed since loaded from cache    */
+
+  ASFGuid              file_guid;        /* from the file properties object    */
+
   GSList              *other_streams;    /* remember streams that are in header but have unknown type */
 
   /* For reverse playback */
@@ -241,9 +297,49 @@ struct _GstASFDemux {
   /* parsing 3D */
   GstASF3DMode asf_3D_mode;
 
+  /* for buffers we have to allocate, e.g. to assemble media objects */
+  GstBufferPool       *pools[GST_ASF_DEMUX_NUM_POOLS];
+
+  /* statistics, updated atomically */
+  gint                 stat_buffers_allocated;  /* without any pool     */
+  gint                 stat_buffers_pooled;     /* from our own pools   */
+  gint                 stat_buffers_downstream; /* from downstream pools */
+  gint                 stat_packets_parsed;
+  gint                 stat_parse_errors;
+  gint                 stat_adapter_bytes;      /* in demux->adapter     */
+  gint                 stat_parse_time;         /* moving average, in ns */
+  gint                 stat_push_time;          /* moving average, in ns */
+
   gboolean saw_file_header;
+
+  /* properties */
+  gboolean buffer_list;  /* push consecutive payloads as buffer lists */
+  gchar *index_cache_dir;  /* where to keep learned indexes, or NULL */
+  guint read_ahead;  /* bytes to pull at once in pull mode, 0 = disabled */
+  guint max_bitrate;  /* bitrate variant to pick in MBR files, 0 = all */
+
+  /* read-ahead data in pull mode */
+  GstBuffer           *ra_buf;
+  guint64              ra_offset;
 };
 
+/* basic information about a file, see gst_asf_demux_probe_header() */
+typedef struct {
+  guint64       header_size;       /* size of the header object            */
+  ASFGuid       file_guid;
+  guint64       num_packets;       /* 0 for broadcasts                     */
+  guint32       packet_size;
+  guint32       max_bitrate;
+  GstClockTime  duration;          /* play time without preroll, or 0      */
+  GstClockTime  preroll;
+  gboolean      broadcast;
+  gboolean      seekable;
+  gboolean      encrypted;
+  guint         num_audio_streams;
+  guint         num_video_streams;
+  guint         num_other_streams;
+} AsfHeaderInfo;
+
 struct _GstASFDemuxClass {
   GstElementClass parent_class;
 };
@@ -254,6 +350,14 @@ AsfStream     * gst_asf_demux_get_stream (GstASFDemux * demux, guint16 id);
 
 gboolean        gst_asf_demux_is_unknown_stream(GstASFDemux *demux, guint stream_num);
 
+GstBuffer     * gst_asf_demux_alloc_buffer (GstASFDemux * demux, AsfStream * stream, gsize size);
+
+void            gst_asf_demux_update_avg_time (gint * p_avg, GstClockTime start);
+
+gboolean        gst_asf_demux_probe_header (const guint8 * data, gsize size, AsfHeaderInfo * info);
+
+void            gst_asf_demux_learn_index_entry (GstASFDemux * demux, AsfStream * stream, GstClockTime ts);
+
 G_END_DECLS
 
 #endif /* __ASF_DEMUX_H__ */
@@ -28,6 +28,11 @@ GST_DEBUG_CATEGORY_STATIC (rdt_jitter_buffer_debug);
 #define MAX_WINDOW	RDT_JITTER_BUFFER_MAX_WINDOW
 #define MAX_TIME	(2 * GST_SECOND)
 
+/* initial number of slots, grows as needed; always a power of 2 */
+#define INITIAL_SIZE	64
+
+#define SLOT(jbuf,seqnum) (&(jbuf)->slots[(seqnum) & ((jbuf)->size - 1)])
+
 /* signals and args */
 enum
 {
@@ -62,7 +67,8 @@ rdt_jitter_buffer_class_init (RDTJitterBufferClass * klass)
 static void
 rdt_jitter_buffer_init (RDTJitterBuffer * jbuf)
 {
-  jbuf->packets = g_queue_new ();
+  jbuf->size = INITIAL_SIZE;
+  jbuf->slots = g_new0 (RDTJitterBufferSlot, jbuf->size);
 
   rdt_jitter_buffer_reset_skew (jbuf);
 }
@@ -75,7 +81,7 @@ rdt_jitter_buffer_finalize (GObject * object)
   jbuf = RDT_JITTER_BUFFER_CAST (object);
 
   rdt_jitter_buffer_flush (jbuf);
-  g_queue_free (jbuf->packets);
+  g_free (jbuf->slots);
 
   G_OBJECT_CLASS (rdt_jitter_buffer_parent_class)->finalize (object);
 }
@@ -327,10 +333,38 @@ no_skew:
   return out_time;
 }
 
+/* makes sure @span consecutive seqnums fit in the ring */
+static void
+rdt_jitter_buffer_ensure_size (RDTJitterBuffer * jbuf, guint span)
+{
+  RDTJitterBufferSlot *old_slots;
+  guint old_size, i;
+
+  if (G_LIKELY (span <= jbuf->size))
+    return;
+
+  old_slots = jbuf->slots;
+  old_size = jbuf->size;
+
+  while (jbuf->size < span)
+    jbuf->size <<= 1;
+
+  GST_DEBUG ("growing ring from %u to %u slots", old_size, jbuf->size);
+
+  jbuf->slots = g_new0 (RDTJitterBufferSlot, jbuf->size);
+  for (i = 0; i < old_size; i++) {
+    if (old_slots[i].buf)
+      *SLOT (jbuf, old_slots[i].seqnum) = old_slots[i];
+  }
+  g_free (old_slots);
+}
+
 /**
  * rdt_jitter_buffer_insert:
  * @jbuf: an #RDTJitterBuffer
  * @buf: a buffer
+ * @seqnum: the sequence number of the first packet in @buf
+ * @rtptime: the timestamp of the first packet in @buf
  * @time: a running_time when this buffer was received in nanoseconds
  * @clock_rate: the clock-rate of the payload of @buf
  * @tail: TRUE when the tail element changed.
@@ -340,70 +374,60 @@ no_skew:
  * @buf when the function returns %TRUE.
  * @buf should have writable metadata when calling this function.
  *
+ * Packets are stored in the slot of their sequence number, so this takes
+ * constant time unless the range of queued sequence numbers outgrows the
+ * ring.
+ *
  * Returns: %FALSE if a packet with the same number already existed.
  */
 gboolean
 rdt_jitter_buffer_insert (RDTJitterBuffer * jbuf, GstBuffer * buf,
-    GstClockTime time, guint32 clock_rate, gboolean * tail)
+    guint16 seqnum, guint32 rtptime, GstClockTime time, guint32 clock_rate,
+    gboolean * tail)
 {
-  GList *list;
-  guint32 rtptime;
-  guint16 seqnum;
-  GstRDTPacket packet;
-  gboolean more;
+  RDTJitterBufferSlot *slot;
+  gboolean is_tail = FALSE;
 
   g_return_val_if_fail (jbuf != NULL, FALSE);
   g_return_val_if_fail (buf != NULL, FALSE);
 
-  more = gst_rdt_buffer_get_first_packet (buf, &packet);
-  /* programmer error */
-  g_return_val_if_fail (more == TRUE, FALSE);
+  if (jbuf->num_packets == 0) {
+    jbuf->low_seqnum = seqnum;
+    jbuf->high_seqnum = seqnum;
+    is_tail = TRUE;
+  } else if (gst_rdt_buffer_compare_seqnum (jbuf->high_seqnum, seqnum) > 0) {
+    /* newer than anything we have, the common case */
+    rdt_jitter_buffer_ensure_size (jbuf,
+        (guint16) (seqnum - jbuf->low_seqnum) + 1);
+    jbuf->high_seqnum = seqnum;
+  } else if (gst_rdt_buffer_compare_seqnum (jbuf->low_seqnum, seqnum) < 0) {
+    /* older than anything we have, becomes the new tail */
+    rdt_jitter_buffer_ensure_size (jbuf,
+        (guint16) (jbuf->high_seqnum - seqnum) + 1);
+    jbuf->low_seqnum = seqnum;
+    is_tail = TRUE;
+  } else if (G_UNLIKELY (SLOT (jbuf, seqnum)->buf != NULL)) {
+    goto duplicate;
+  }
 
-  seqnum = gst_rdt_packet_data_get_seq (&packet);
   /* do skew calculation by measuring the difference between rtptime and the
    * receive time, this function will retimestamp @buf with the skew corrected
    * running time. */
-  rtptime = gst_rdt_packet_data_get_timestamp (&packet);
-
-  /* loop the list to skip strictly smaller seqnum buffers */
-  for (list = jbuf->packets->head; list; list = g_list_next (list)) {
-    guint16 qseq;
-    gint gap;
-
-    more =
-        gst_rdt_buffer_get_first_packet (GST_BUFFER_CAST (list->data), &packet);
-    /* programmer error */
-    g_return_val_if_fail (more == TRUE, FALSE);
-
-    qseq = gst_rdt_packet_data_get_seq (&packet);
-
-    /* compare the new seqnum to the one in the buffer */
-    gap = gst_rdt_buffer_compare_seqnum (seqnum, qseq);
-
-    /* we hit a packet with the same seqnum, notify a duplicate */
-    if (G_UNLIKELY (gap == 0))
-      goto duplicate;
-
-    /* seqnum > qseq, we can stop looking */
-    if (G_LIKELY (gap < 0))
-      break;
-  }
-
-
   if (clock_rate) {
     time = calculate_skew (jbuf, rtptime, time, clock_rate);
     GST_BUFFER_TIMESTAMP (buf) = time;
   }
 
-  if (list)
-    g_queue_insert_before (jbuf->packets, list, buf);
-  else
-    g_queue_push_tail (jbuf->packets, buf);
+  slot = SLOT (jbuf, seqnum);
+  slot->buf = buf;
+  slot->seqnum = seqnum;
+  slot->rtptime = rtptime;
+  jbuf->num_packets++;
 
-  /* tail was changed when we did not find a previous packet, we set the return
+  /* tail was changed when there was no older packet, we set the return
    * flag when requested. */
   if (tail)
-    *tail = (list == NULL);
+    *tail = is_tail;
 
   return TRUE;
 
@@ -428,11 +452,25 @@ duplicate:
 GstBuffer *
 rdt_jitter_buffer_pop (RDTJitterBuffer * jbuf)
 {
+  RDTJitterBufferSlot *slot;
   GstBuffer *buf;
 
   g_return_val_if_fail (jbuf != NULL, FALSE);
 
-  buf = g_queue_pop_tail (jbuf->packets);
+  if (jbuf->num_packets == 0)
+    return NULL;
+
+  slot = SLOT (jbuf, jbuf->low_seqnum);
+  buf = slot->buf;
+  slot->buf = NULL;
+  jbuf->num_packets--;
+
+  /* skip the slots of missing packets to the next oldest one */
+  if (jbuf->num_packets > 0) {
+    do {
+      jbuf->low_seqnum++;
+    } while (SLOT (jbuf, jbuf->low_seqnum)->buf == NULL);
+  }
 
   return buf;
 }
@@ -450,13 +488,12 @@ rdt_jitter_buffer_pop (RDTJitterBuffer * jbuf)
 GstBuffer *
 rdt_jitter_buffer_peek (RDTJitterBuffer * jbuf)
 {
-  GstBuffer *buf;
-
   g_return_val_if_fail (jbuf != NULL, FALSE);
 
-  buf = g_queue_peek_tail (jbuf->packets);
+  if (jbuf->num_packets == 0)
+    return NULL;
 
-  return buf;
+  return SLOT (jbuf, jbuf->low_seqnum)->buf;
 }
 
 /**
@@ -468,12 +505,17 @@ rdt_jitter_buffer_peek (RDTJitterBuffer * jbuf)
 void
 rdt_jitter_buffer_flush (RDTJitterBuffer * jbuf)
 {
-  GstBuffer *buffer;
+  guint i;
 
   g_return_if_fail (jbuf != NULL);
 
-  while ((buffer = g_queue_pop_head (jbuf->packets)))
-    gst_buffer_unref (buffer);
+  for (i = 0; i < jbuf->size && jbuf->num_packets > 0; i++) {
+    if (jbuf->slots[i].buf) {
+      gst_buffer_unref (jbuf->slots[i].buf);
+      jbuf->slots[i].buf = NULL;
+      jbuf->num_packets--;
+    }
+  }
 }
 
 /**
@@ -489,7 +531,34 @@ rdt_jitter_buffer_num_packets (RDTJitterBuffer * jbuf)
 {
   g_return_val_if_fail (jbuf != NULL, 0);
 
-  return jbuf->packets->length;
+  return jbuf->num_packets;
+}
+
+/**
+ * rdt_jitter_buffer_get_seqnum_range:
+ * @jbuf: an #RDTJitterBuffer
+ * @low: (out) (optional): the seqnum of the oldest packet
+ * @high: (out) (optional): the seqnum of the newest packet
+ *
+ * Get the range of sequence numbers of the packets in @jbuf.
+ *
+ * Returns: %FALSE when there are no packets in @jbuf.
+ */
+gboolean
+rdt_jitter_buffer_get_seqnum_range (RDTJitterBuffer * jbuf, guint16 * low,
+    guint16 * high)
+{
+  g_return_val_if_fail (jbuf != NULL, FALSE);
+
+  if (jbuf->num_packets == 0)
+    return FALSE;
+
+  if (low)
+    *low = jbuf->low_seqnum;
+  if (high)
+    *high = jbuf->high_seqnum;
+
+  return TRUE;
 }
 
 /**
@@ -505,21 +574,15 @@ guint32
 rdt_jitter_buffer_get_ts_diff (RDTJitterBuffer * jbuf)
 {
   guint64 high_ts, low_ts;
-  GstBuffer *high_buf, *low_buf;
   guint32 result;
 
   g_return_val_if_fail (jbuf != NULL, 0);
 
-  high_buf = g_queue_peek_head (jbuf->packets);
-  low_buf = g_queue_peek_tail (jbuf->packets);
-
-  if (!high_buf || !low_buf || high_buf == low_buf)
+  if (jbuf->num_packets < 2)
     return 0;
 
-  //high_ts = gst_rtp_buffer_get_timestamp (high_buf);
-  //low_ts = gst_rtp_buffer_get_timestamp (low_buf);
-  high_ts = 0;
-  low_ts = 0;
+  high_ts = SLOT (jbuf, jbuf->high_seqnum)->rtptime;
+  low_ts = SLOT (jbuf, jbuf->low_seqnum)->rtptime;
 
   /* it needs to work if ts wraps */
   if (high_ts >= low_ts) {
@@ -42,6 +42,13 @@ typedef struct _RDTJitterBufferClass RDTJitterBufferClass;
 typedef void (*RTPTailChanged) (RDTJitterBuffer *jbuf, gpointer user_data);
 
 #define RDT_JITTER_BUFFER_MAX_WINDOW 512
+
+typedef struct {
+  GstBuffer     *buf;
+  guint16        seqnum;
+  guint32        rtptime;
+} RDTJitterBufferSlot;
+
 /**
  * RDTJitterBuffer:
  *
@@ -50,7 +57,13 @@ typedef void (*RTPTailChanged) (RDTJitterBuffer *jbuf, gpointer user_data);
 struct _RDTJitterBuffer {
   GObject        object;
 
-  GQueue        *packets;
+  /* packets in a ring indexed by seqnum, from the oldest one in low_seqnum to
+   * the newest one in high_seqnum, with empty slots for missing packets */
+  RDTJitterBufferSlot *slots;
+  guint          size;
+  guint          num_packets;
+  guint16        low_seqnum;
+  guint16        high_seqnum;
 
   /* for calculating skew */
   GstClockTime   base_time;
@@ -77,6 +90,7 @@ RDTJitterBuffer*      rdt_jitter_buffer_new              (void);
 void                  rdt_jitter_buffer_reset_skew       (RDTJitterBuffer *jbuf);
 
 gboolean              rdt_jitter_buffer_insert           (RDTJitterBuffer *jbuf, GstBuffer *buf,
+		                                          guint16 seqnum, guint32 rtptime,
 		                                          GstClockTime time,
 		                                          guint32 clock_rate,
 		                                          gboolean *tail);
@@ -86,6 +100,8 @@ GstBuffer *           rdt_jitter_buffer_pop              (RDTJitterBuffer *jbuf)
 void                  rdt_jitter_buffer_flush            (RDTJitterBuffer *jbuf);
 
 guint                 rdt_jitter_buffer_num_packets      (RDTJitterBuffer *jbuf);
+gboolean              rdt_jitter_buffer_get_seqnum_range (RDTJitterBuffer *jbuf, guint16 *low,
+                                                          guint16 *high);
 guint32               rdt_jitter_buffer_get_ts_diff      (RDTJitterBuffer *jbuf);
 
 #endif /* __RDT_JITTER_BUFFER_H__ */
@@ -82,13 +82,42 @@ enum
 };
 
 #define DEFAULT_LATENCY_MS      200
+#define DEFAULT_MODE            GST_RDT_MANAGER_MODE_LOW_LATENCY
+#define DEFAULT_DO_RETRANSMISSION FALSE
+#define DEFAULT_RTX_INTERVAL_MS 100
+
+/* the most packets requested in one ack packet */
+#define MAX_ACK_PACKETS         1024
 
 enum
 {
   PROP_0,
-  PROP_LATENCY
+  PROP_LATENCY,
+  PROP_MODE,
+  PROP_DO_RETRANSMISSION,
+  PROP_RETRANSMISSION_INTERVAL,
+  PROP_STATS
 };
 
+GType
+gst_rdt_manager_mode_get_type (void)
+{
+  static GType rdt_manager_mode_type = 0;
+  static const GEnumValue rdt_manager_modes[] = {
+    {GST_RDT_MANAGER_MODE_LOW_LATENCY,
+        "Push out packets as soon as they arrive", "low-latency"},
+    {GST_RDT_MANAGER_MODE_REORDER,
+        "Wait up to the latency for missing packets", "reorder"},
+    {0, NULL, NULL},
+  };
+
+  if (!rdt_manager_mode_type) {
+    rdt_manager_mode_type =
+        g_enum_register_static ("GstRDTManagerMode", rdt_manager_modes);
+  }
+  return rdt_manager_mode_type;
+}
+
 static GstStaticPadTemplate gst_rdt_manager_recv_rtp_sink_template =
 GST_STATIC_PAD_TEMPLATE ("recv_rtp_sink_%u",
     GST_PAD_SINK,
@@ -217,6 +246,16 @@ struct _GstRDTManagerSession
   /* some accounting */
   guint64 num_late;
   guint64 num_duplicates;
+  guint64 num_received;
+  guint64 num_lost;
+  /* the highest seqnum received and how far behind it packets arrived */
+  guint32 highest_seqnum;
+  guint max_reorder;
+
+  /* for requesting retransmissions */
+  guint16 stream_id;
+  GstClockTime last_ack_time;
+  GArray *rtx_pending;          /* seqnums lost and not requested yet */
 };
 
 /* find a session with the given id */
@@ -244,9 +283,13 @@ create_session (GstRDTManager * rdtmanager, gint id)
   sess->id = id;
   sess->dec = rdtmanager;
   sess->jbuf = rdt_jitter_buffer_new ();
+  sess->last_ack_time = GST_CLOCK_TIME_NONE;
+  sess->rtx_pending = g_array_new (FALSE, FALSE, sizeof (guint16));
   g_mutex_init (&sess->jbuf_lock);
   g_cond_init (&sess->jbuf_cond);
+  GST_OBJECT_LOCK (rdtmanager);
   rdtmanager->sessions = g_slist_prepend (rdtmanager->sessions, sess);
+  GST_OBJECT_UNLOCK (rdtmanager);
 
   return sess;
 }
@@ -330,6 +373,7 @@ static void
 free_session (GstRDTManagerSession * session)
 {
   g_object_unref (session->jbuf);
+  g_array_free (session->rtx_pending, TRUE);
   g_cond_clear (&session->jbuf_cond);
   g_mutex_clear (&session->jbuf_lock);
   g_free (session);
@@ -427,6 +471,68 @@ gst_rdt_manager_class_init (GstRDTManagerClass * g_class)
           "Amount of ms to buffer", 0, G_MAXUINT, DEFAULT_LATENCY_MS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRDTManager:mode:
+   *
+   * How to handle packets arriving out of order. In reorder mode, packets
+   * following a gap are held back until their running time plus the latency,
+   * to give the missing packets a chance to arrive. After that the missing
+   * ones are considered lost, and dropped if they arrive later still.
+   */
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode",
+          "How to handle packets arriving out of order",
+          GST_TYPE_RDT_MANAGER_MODE, DEFAULT_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRDTManager:do-retransmission:
+   *
+   * Request the retransmission of missing packets with RDT ack packets on
+   * the rtcp_src pad of the session. Works best in reorder mode, which gives
+   * the retransmitted packets time to arrive.
+   */
+  g_object_class_install_property (gobject_class, PROP_DO_RETRANSMISSION,
+      g_param_spec_boolean ("do-retransmission", "Do Retransmission",
+          "Request retransmission of missing packets",
+          DEFAULT_DO_RETRANSMISSION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRDTManager:retransmission-interval:
+   *
+   * The minimum time between two retransmission requests of a session, so a
+   * burst of losses doesn't flood the sender with requests.
+   */
+  g_object_class_install_property (gobject_class, PROP_RETRANSMISSION_INTERVAL,
+      g_param_spec_uint ("retransmission-interval", "Retransmission Interval",
+          "Minimum time between retransmission requests in ms", 0, G_MAXUINT,
+          DEFAULT_RTX_INTERVAL_MS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRDTManager:stats:
+   *
+   * Statistics of the receiving sessions, to notice degraded feeds. Contains
+   * a "sessions" #GST_TYPE_ARRAY with a structure per session:
+   *
+   * - "session"            G_TYPE_UINT    the session id
+   * - "packets-received"   G_TYPE_UINT64  packets received, without duplicates
+   * - "packets-lost"       G_TYPE_UINT64  packets missing when pushing out
+   * - "packets-late"       G_TYPE_UINT64  packets that arrived after newer
+   *                        ones were pushed out already
+   * - "duplicates"         G_TYPE_UINT64  packets received more than once
+   * - "max-reorder"        G_TYPE_UINT    the most packets one arrived behind
+   *                        the newest one received
+   * - "skew"               G_TYPE_INT64   the current clock skew, in
+   *                        nanoseconds
+   * - "queue-fill"         G_TYPE_UINT    packets in the jitterbuffer
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Statistics of the sessions", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstRDTManager::request-pt-map:
    * @rdtmanager: the object which received the signal
@@ -534,6 +640,8 @@ gst_rdt_manager_class_init (GstRDTManagerClass * g_class)
       "Wim Taymans <wim.taymans@gmail.com>");
 
   GST_DEBUG_CATEGORY_INIT (rdtmanager_debug, "rdtmanager", 0, "RTP decoder");
+
+  gst_type_mark_as_plugin_api (GST_TYPE_RDT_MANAGER_MODE, 0);
 }
 
 static void
@@ -541,6 +649,9 @@ gst_rdt_manager_init (GstRDTManager * rdtmanager)
 {
   rdtmanager->provided_clock = gst_system_clock_obtain ();
   rdtmanager->latency = DEFAULT_LATENCY_MS;
+  rdtmanager->mode = DEFAULT_MODE;
+  rdtmanager->do_retransmission = DEFAULT_DO_RETRANSMISSION;
+  rdtmanager->rtx_interval = DEFAULT_RTX_INTERVAL_MS;
   GST_OBJECT_FLAG_SET (rdtmanager, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 }
 
@@ -609,6 +720,9 @@ gst_rdt_manager_src_activate_mode (GstPad * pad, GstObject * parent,
         session->srcresult = GST_FLOW_OK;
         gst_segment_init (&session->segment, GST_FORMAT_TIME);
         session->last_popped_seqnum = -1;
+        session->highest_seqnum = -1;
+        session->last_ack_time = GST_CLOCK_TIME_NONE;
+        g_array_set_size (session->rtx_pending, 0);
         session->last_out_time = -1;
         session->next_seqnum = -1;
         session->eos = FALSE;
@@ -646,21 +760,152 @@ gst_rdt_manager_src_activate_mode (GstPad * pad, GstObject * parent,
   return result;
 }
 
+/* remembers the packets between @from and @to, not included, as lost so
+ * that the next ack asks for them. Called with the JBUF_LOCK. */
+static void
+gst_rdt_manager_add_losses (GstRDTManagerSession * session, guint16 from,
+    guint16 to)
+{
+  guint16 seqnum;
+
+  for (seqnum = from; seqnum != to; seqnum++) {
+    if (session->rtx_pending->len >= MAX_ACK_PACKETS) {
+      GST_DEBUG_OBJECT (session->dec, "too many losses, not requesting #%u "
+          "to #%u", seqnum, (guint16) (to - 1));
+      break;
+    }
+    g_array_append_val (session->rtx_pending, seqnum);
+  }
+}
+
+/* forgets about a lost packet that arrived before it was requested. Called
+ * with the JBUF_LOCK. */
+static void
+gst_rdt_manager_remove_loss (GstRDTManagerSession * session, guint16 seqnum)
+{
+  guint i;
+
+  for (i = 0; i < session->rtx_pending->len; i++) {
+    if (g_array_index (session->rtx_pending, guint16, i) == seqnum) {
+      g_array_remove_index (session->rtx_pending, i);
+      break;
+    }
+  }
+}
+
+/* builds an ack packet requesting the lost packets that were not requested
+ * yet, or returns NULL when there are none. Losses stay pending while the
+ * rate limit holds acks back, whether or not the packets after them were
+ * pushed out already. Called with the JBUF_LOCK.
+ *
+ * The lost_high flag is set, so the set bits of the mask mark lost packets:
+ *
+ *   length_included_flag:1 lost_high:1 dummy:6
+ *   packet_type:16          GST_RDT_TYPE_ACK
+ *   packet_length:16
+ *   stream_id:16
+ *   first_seqnum:16         the oldest missing packet
+ *   bit_count:16
+ *   bitmask                 a bit per packet from first_seqnum, MSB first
+ */
+static GstBuffer *
+gst_rdt_manager_create_ack (GstRDTManagerSession * session)
+{
+  GArray *pending = session->rtx_pending;
+  guint16 first;
+  guint num, count, size, i;
+  guint8 *data;
+
+  if (pending->len == 0)
+    return NULL;
+
+  /* the losses are kept in seqnum order, take the ones that fit in a mask
+   * and leave the others for the next ack */
+  first = g_array_index (pending, guint16, 0);
+  count = 0;
+  for (num = 0; num < pending->len; num++) {
+    guint bit = (guint16) (g_array_index (pending, guint16, num) - first);
+
+    if (bit >= MAX_ACK_PACKETS)
+      break;
+    count = bit + 1;
+  }
+  size = 11 + (count + 7) / 8;
+
+  data = g_malloc0 (size);
+  data[0] = 0xc0;
+  GST_WRITE_UINT16_BE (&data[1], GST_RDT_TYPE_ACK);
+  GST_WRITE_UINT16_BE (&data[3], size);
+  GST_WRITE_UINT16_BE (&data[5], session->stream_id);
+  GST_WRITE_UINT16_BE (&data[7], first);
+  GST_WRITE_UINT16_BE (&data[9], count);
+  for (i = 0; i < num; i++) {
+    guint bit = (guint16) (g_array_index (pending, guint16, i) - first);
+
+    data[11 + bit / 8] |= 0x80 >> (bit % 8);
+  }
+  g_array_remove_range (pending, 0, num);
+
+  GST_DEBUG_OBJECT (session->dec, "requesting retransmission of %u packets "
+      "from #%u", num, first);
+
+  return gst_buffer_new_wrapped (data, size);
+}
+
+static void
+gst_rdt_manager_push_ack (GstRDTManagerSession * session, GstBuffer * buffer)
+{
+  GstPad *pad = session->rtcp_src;
+  GstEvent *event;
+  GstFlowReturn res;
+
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_STREAM_START, 0);
+  if (event == NULL) {
+    GstSegment segment;
+    GstCaps *caps;
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id_printf (pad,
+        GST_ELEMENT_CAST (session->dec), "rtcp_%u", session->id);
+    gst_pad_push_event (pad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+
+    caps = gst_pad_get_pad_template_caps (pad);
+    gst_pad_push_event (pad, gst_event_new_caps (caps));
+    gst_caps_unref (caps);
+
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    gst_pad_push_event (pad, gst_event_new_segment (&segment));
+  } else {
+    gst_event_unref (event);
+  }
+
+  /* the sender not hearing about it is no reason to stop receiving */
+  res = gst_pad_push (pad, buffer);
+  if (res != GST_FLOW_OK)
+    GST_DEBUG_OBJECT (session->dec, "pushing ack failed: %s",
+        gst_flow_get_name (res));
+}
+
 static GstFlowReturn
 gst_rdt_manager_handle_data_packet (GstRDTManagerSession * session,
     GstClockTime timestamp, GstRDTPacket * packet)
 {
   GstRDTManager *rdtmanager;
-  guint16 seqnum;
+  guint16 seqnum, stream_id;
+  guint32 rtptime;
   gboolean tail;
   GstFlowReturn res;
-  GstBuffer *buffer;
+  GstBuffer *buffer, *ack = NULL;
 
   rdtmanager = session->dec;
 
   res = GST_FLOW_OK;
 
-  seqnum = 0;
+  /* parse the packet before taking the lock, the loop is waiting on it */
+  seqnum = gst_rdt_packet_data_get_seq (packet);
+  rtptime = gst_rdt_packet_data_get_timestamp (packet);
+  stream_id = gst_rdt_packet_data_get_stream_id (packet);
   GST_DEBUG_OBJECT (rdtmanager,
       "Received packet #%d at time %" GST_TIME_FORMAT, seqnum,
       GST_TIME_ARGS (timestamp));
@@ -669,18 +914,51 @@ gst_rdt_manager_handle_data_packet (GstRDTManagerSession * session,
 
   JBUF_LOCK_CHECK (session, out_flushing);
 
-  /* insert the packet into the queue now, FIXME, use seqnum */
-  if (!rdt_jitter_buffer_insert (session->jbuf, buffer, timestamp,
-          session->clock_rate, &tail))
+  /* insert the packet into the queue now */
+  if (!rdt_jitter_buffer_insert (session->jbuf, buffer, seqnum, rtptime,
+          timestamp, session->clock_rate, &tail))
     goto duplicate;
 
+  session->num_received++;
+  if (session->highest_seqnum == -1 ||
+      gst_rdt_buffer_compare_seqnum (session->highest_seqnum, seqnum) > 0) {
+    if (rdtmanager->do_retransmission && session->highest_seqnum != -1)
+      gst_rdt_manager_add_losses (session, session->highest_seqnum + 1, seqnum);
+    session->highest_seqnum = seqnum;
+  } else {
+    guint reorder;
+
+    reorder = gst_rdt_buffer_compare_seqnum (seqnum, session->highest_seqnum);
+    session->max_reorder = MAX (session->max_reorder, reorder);
+    if (rdtmanager->do_retransmission)
+      gst_rdt_manager_remove_loss (session, seqnum);
+  }
+  session->stream_id = stream_id;
+
+  /* ask for missing packets, at most once per interval */
+  if (rdtmanager->do_retransmission && session->rtcp_src &&
+      GST_CLOCK_TIME_IS_VALID (timestamp) &&
+      (!GST_CLOCK_TIME_IS_VALID (session->last_ack_time) ||
+          timestamp >= session->last_ack_time +
+          rdtmanager->rtx_interval * GST_MSECOND)) {
+    ack = gst_rdt_manager_create_ack (session);
+    if (ack)
+      session->last_ack_time = timestamp;
+  }
+
   /* signal addition of new buffer when the _loop is waiting. */
   if (session->waiting)
     JBUF_SIGNAL (session);
+  /* a new oldest packet might fill the gap the _loop is waiting on */
+  else if (tail && session->clock_id)
+    gst_clock_id_unschedule (session->clock_id);
 
 finished:
   JBUF_UNLOCK (session);
 
+  if (ack)
+    gst_rdt_manager_push_ack (session, ack);
+
   return res;
 
   /* ERRORS */
@@ -854,6 +1132,79 @@ gst_rdt_manager_chain_rdt (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   return res;
 }
 
+/* returns the running time until which to wait for the packets missing
+ * before the oldest one queued, or NONE when nothing is missing */
+static GstClockTime
+gst_rdt_manager_get_deadline (GstRDTManager * rdtmanager,
+    GstRDTManagerSession * session)
+{
+  GstBuffer *buffer;
+  guint16 seqnum;
+
+  if (session->last_popped_seqnum == -1 || session->eos)
+    return GST_CLOCK_TIME_NONE;
+
+  if (!rdt_jitter_buffer_get_seqnum_range (session->jbuf, &seqnum, NULL))
+    return GST_CLOCK_TIME_NONE;
+
+  if (gst_rdt_buffer_compare_seqnum (session->last_popped_seqnum, seqnum) <= 1)
+    return GST_CLOCK_TIME_NONE;
+
+  buffer = rdt_jitter_buffer_peek (session->jbuf);
+  if (!GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
+    return GST_CLOCK_TIME_NONE;
+
+  return GST_BUFFER_TIMESTAMP (buffer) + rdtmanager->latency * GST_MSECOND;
+}
+
+/* waits until @deadline, called and returns with the JBUF_LOCK. Returns
+ * GST_CLOCK_UNSCHEDULED when the wait was interrupted and the queue needs
+ * to be looked at again. */
+static GstClockReturn
+gst_rdt_manager_wait_deadline (GstRDTManager * rdtmanager,
+    GstRDTManagerSession * session, GstClockTime deadline)
+{
+  GstClock *clock;
+  GstClockTime base_time;
+  GstClockID id;
+  GstClockReturn ret;
+
+  /* don't take the object lock with the JBUF_LOCK held, the stats do it the
+   * other way around */
+  JBUF_UNLOCK (session);
+  GST_OBJECT_LOCK (rdtmanager);
+  clock = GST_ELEMENT_CLOCK (rdtmanager);
+  if (clock == NULL) {
+    GST_OBJECT_UNLOCK (rdtmanager);
+    JBUF_LOCK (session);
+    /* not playing, nothing to wait for */
+    return GST_CLOCK_OK;
+  }
+  base_time = GST_ELEMENT_CAST (rdtmanager)->base_time;
+  id = gst_clock_new_single_shot_id (clock, base_time + deadline);
+  GST_OBJECT_UNLOCK (rdtmanager);
+  JBUF_LOCK (session);
+
+  /* things might have changed while we didn't hold the lock */
+  if (session->srcresult != GST_FLOW_OK ||
+      gst_rdt_manager_get_deadline (rdtmanager, session) != deadline) {
+    gst_clock_id_unref (id);
+    return GST_CLOCK_UNSCHEDULED;
+  }
+
+  GST_DEBUG_OBJECT (rdtmanager, "waiting for missing packets until %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (deadline));
+
+  session->clock_id = id;
+  JBUF_UNLOCK (session);
+  ret = gst_clock_id_wait (id, NULL);
+  JBUF_LOCK (session);
+  session->clock_id = NULL;
+  gst_clock_id_unref (id);
+
+  return ret;
+}
+
 /* push packets from the queue to the downstream demuxer */
 static void
 gst_rdt_manager_loop (GstPad * pad)
@@ -862,6 +1213,9 @@ gst_rdt_manager_loop (GstPad * pad)
   GstRDTManagerSession *session;
   GstBuffer *buffer;
   GstFlowReturn result;
+  GstClockTime deadline;
+  guint16 seqnum;
+  gboolean late = FALSE, duplicate = FALSE;
 
   rdtmanager = GST_RDT_MANAGER (GST_PAD_PARENT (pad));
 
@@ -869,6 +1223,7 @@ gst_rdt_manager_loop (GstPad * pad)
 
   JBUF_LOCK_CHECK (session, flushing);
   GST_DEBUG_OBJECT (rdtmanager, "Peeking item");
+again:
   while (TRUE) {
     /* always wait if we are blocked */
     if (!session->blocked) {
@@ -885,9 +1240,55 @@ gst_rdt_manager_loop (GstPad * pad)
     session->waiting = FALSE;
   }
 
+  if (rdtmanager->mode == GST_RDT_MANAGER_MODE_REORDER) {
+    deadline = gst_rdt_manager_get_deadline (rdtmanager, session);
+    if (GST_CLOCK_TIME_IS_VALID (deadline)) {
+      GstClockReturn ret;
+
+      ret = gst_rdt_manager_wait_deadline (rdtmanager, session, deadline);
+      if (session->srcresult != GST_FLOW_OK)
+        goto flushing;
+      if (ret == GST_CLOCK_UNSCHEDULED)
+        goto again;
+    }
+  }
+
+  rdt_jitter_buffer_get_seqnum_range (session->jbuf, &seqnum, NULL);
   buffer = rdt_jitter_buffer_pop (session->jbuf);
 
-  GST_DEBUG_OBJECT (rdtmanager, "Got item %p", buffer);
+  GST_DEBUG_OBJECT (rdtmanager, "Got item %p, seqnum %u", buffer, seqnum);
+
+  if (session->last_popped_seqnum != -1) {
+    gint gap;
+
+    gap = gst_rdt_buffer_compare_seqnum (session->last_popped_seqnum, seqnum);
+    if (gap > 1) {
+      session->num_lost += gap - 1;
+    } else if (gap == 0) {
+      /* the queue can't tell once the first one was pushed out */
+      session->num_duplicates++;
+      session->num_received--;
+      duplicate = TRUE;
+    } else if (gap < 0) {
+      /* we counted it as lost when pushing out the newer ones */
+      session->num_late++;
+      if (session->num_lost > 0)
+        session->num_lost--;
+      late = TRUE;
+    }
+    if (gap > 0)
+      session->last_popped_seqnum = seqnum;
+  } else {
+    session->last_popped_seqnum = seqnum;
+  }
+
+  if (duplicate || (late && rdtmanager->mode == GST_RDT_MANAGER_MODE_REORDER)) {
+    GST_DEBUG_OBJECT (rdtmanager, "dropping %s packet #%u",
+        duplicate ? "duplicate" : "late", seqnum);
+    gst_buffer_unref (buffer);
+    JBUF_UNLOCK (session);
+    return;
+  }
 
   if (session->discont) {
     GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
@@ -1106,12 +1507,59 @@ gst_rdt_manager_set_property (GObject * object, guint prop_id,
     case PROP_LATENCY:
       src->latency = g_value_get_uint (value);
       break;
+    case PROP_MODE:
+      src->mode = g_value_get_enum (value);
+      break;
+    case PROP_DO_RETRANSMISSION:
+      src->do_retransmission = g_value_get_boolean (value);
+      break;
+    case PROP_RETRANSMISSION_INTERVAL:
+      src->rtx_interval = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static GstStructure *
+gst_rdt_manager_get_stats (GstRDTManager * rdtmanager)
+{
+  GValue sessions = G_VALUE_INIT;
+  GSList *walk;
+  GstStructure *s;
+
+  g_value_init (&sessions, GST_TYPE_ARRAY);
+
+  GST_OBJECT_LOCK (rdtmanager);
+  for (walk = rdtmanager->sessions; walk; walk = g_slist_next (walk)) {
+    GstRDTManagerSession *session = (GstRDTManagerSession *) walk->data;
+    GValue val = G_VALUE_INIT;
+
+    JBUF_LOCK (session);
+    g_value_init (&val, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&val, gst_structure_new ("application/x-rdt-session",
+            "session", G_TYPE_UINT, (guint) session->id,
+            "packets-received", G_TYPE_UINT64, session->num_received,
+            "packets-lost", G_TYPE_UINT64, session->num_lost,
+            "packets-late", G_TYPE_UINT64, session->num_late,
+            "duplicates", G_TYPE_UINT64, session->num_duplicates,
+            "max-reorder", G_TYPE_UINT, session->max_reorder,
+            "skew", G_TYPE_INT64, session->jbuf->skew,
+            "queue-fill", G_TYPE_UINT,
+            rdt_jitter_buffer_num_packets (session->jbuf), NULL));
+    JBUF_UNLOCK (session);
+
+    gst_value_array_append_and_take_value (&sessions, &val);
+  }
+  GST_OBJECT_UNLOCK (rdtmanager);
+
+  s = gst_structure_new_empty ("application/x-rdt-manager-stats");
+  gst_structure_take_value (s, "sessions", &sessions);
+
+  return s;
+}
+
 static void
 gst_rdt_manager_get_property (GObject * object, guint prop_id, GValue * value,
     GParamSpec * pspec)
@@ -1124,6 +1572,18 @@ gst_rdt_manager_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_LATENCY:
       g_value_set_uint (value, src->latency);
       break;
+    case PROP_MODE:
+      g_value_set_enum (value, src->mode);
+      break;
+    case PROP_DO_RETRANSMISSION:
+      g_value_set_boolean (value, src->do_retransmission);
+      break;
+    case PROP_RETRANSMISSION_INTERVAL:
+      g_value_set_uint (value, src->rtx_interval);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rdt_manager_get_stats (src));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -57,10 +57,27 @@ typedef struct _GstRDTManager GstRDTManager;
 typedef struct _GstRDTManagerClass GstRDTManagerClass;
 typedef struct _GstRDTManagerSession GstRDTManagerSession;
 
+/**
+ * GstRDTManagerMode:
+ * @GST_RDT_MANAGER_MODE_LOW_LATENCY: push out packets as soon as they arrive
+ * @GST_RDT_MANAGER_MODE_REORDER: hold back packets after a gap for up to the
+ *   latency, so missing ones can still arrive, and drop late packets
+ */
+typedef enum {
+  GST_RDT_MANAGER_MODE_LOW_LATENCY,
+  GST_RDT_MANAGER_MODE_REORDER
+} GstRDTManagerMode;
+
+#define GST_TYPE_RDT_MANAGER_MODE (gst_rdt_manager_mode_get_type())
+GType gst_rdt_manager_mode_get_type (void);
+
 struct _GstRDTManager {
   GstElement  element;
 
   guint       latency;
+  GstRDTManagerMode mode;
+  gboolean    do_retransmission;
+  guint       rtx_interval;
   GSList     *sessions;
   GstClock   *provided_clock;
 };
@@ -42,6 +42,15 @@
 
 #define MAX_FRAGS 256
 
+/* when building an index from the data packets, they are read in chunks of
+ * this size, and an entry is added at most every INDEX_SCAN_INTERVAL. A scan
+ * for a seek stops INDEX_SCAN_AHEAD past the seek target, packets of
+ * different streams are not strictly in timestamp order. */
+#define INDEX_SCAN_CHUNK_SIZE (64 * 1024)
+#define INDEX_SCAN_INTERVAL (500 * GST_MSECOND)
+#define INDEX_SCAN_AHEAD GST_SECOND
+#define PACKET_HEADER_SIZE 12
+
 static const guint8 sipr_subpk_size[4] = { 29, 19, 37, 20 };
 
 typedef struct _GstRMDemuxIndex GstRMDemuxIndex;
@@ -81,6 +90,10 @@ struct _GstRMDemuxStream
   gboolean needs_descrambling;
   guint subpackets_needed;      /* subpackets needed for descrambling    */
   GPtrArray *subpackets;        /* array containing subpacket GstBuffers */
+  guint *leaf_perm;             /* source leaf for each output leaf      */
+  guint16 leaf_perm_height;     /* layout leaf_perm was computed for     */
+  guint32 leaf_perm_packet_size;
+  guint16 leaf_perm_leaf_size;
 
   /* Variables needed for fixing timestamps. */
   GstClockTime next_ts, last_ts;
@@ -94,6 +107,9 @@ struct _GstRMDemuxStream
   guint frag_offset[MAX_FRAGS];
   GstAdapter *adapter;
 
+  GstBufferPool *pool;          /* pool proposed by downstream */
+  guint pool_size;
+
   GstTagList *pending_tags;
 };
 
@@ -127,10 +143,18 @@ GST_DEBUG_CATEGORY_STATIC (rmdemux_debug);
 
 static GstElementClass *parent_class = NULL;
 
+enum
+{
+  PROP_0,
+  PROP_STATS
+};
+
 static void gst_rmdemux_class_init (GstRMDemuxClass * klass);
 static void gst_rmdemux_base_init (GstRMDemuxClass * klass);
 static void gst_rmdemux_init (GstRMDemux * rmdemux);
 static void gst_rmdemux_finalize (GObject * object);
+static void gst_rmdemux_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static GstStateChangeReturn gst_rmdemux_change_state (GstElement * element,
     GstStateChange transition);
 static GstFlowReturn gst_rmdemux_chain (GstPad * pad, GstObject * parent,
@@ -226,6 +250,50 @@ gst_rmdemux_class_init (GstRMDemuxClass * klass)
       0, "Demuxer for Realmedia streams");
 
   gobject_class->finalize = gst_rmdemux_finalize;
+  gobject_class->get_property = gst_rmdemux_get_property;
+
+  /**
+   * GstRMDemux:stats:
+   *
+   * Various statistics. This property returns a GstStructure with name
+   * application/x-rmdemux-stats with the following fields:
+   *
+   * - "buffers-allocated"  G_TYPE_UINT  buffers allocated without a pool
+   * - "buffers-pooled"     G_TYPE_UINT  buffers taken from the internal pools
+   * - "buffers-downstream" G_TYPE_UINT  buffers taken from downstream pools
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Various statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+static GstStructure *
+gst_rmdemux_get_stats (GstRMDemux * rmdemux)
+{
+  return gst_structure_new ("application/x-rmdemux-stats",
+      "buffers-allocated", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&rmdemux->stat_buffers_allocated),
+      "buffers-pooled", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&rmdemux->stat_buffers_pooled),
+      "buffers-downstream", G_TYPE_UINT,
+      (guint) g_atomic_int_get (&rmdemux->stat_buffers_downstream), NULL);
+}
+
+static void
+gst_rmdemux_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstRMDemux *rmdemux = GST_RMDEMUX (object);
+
+  switch (prop_id) {
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_rmdemux_get_stats (rmdemux));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
 
 static void
@@ -241,6 +309,10 @@ gst_rmdemux_finalize (GObject * object)
     gst_flow_combiner_free (rmdemux->flowcombiner);
     rmdemux->flowcombiner = NULL;
   }
+  if (rmdemux->seek_index) {
+    g_array_free (rmdemux->seek_index, TRUE);
+    rmdemux->seek_index = NULL;
+  }
 
   GST_CALL_PARENT (G_OBJECT_CLASS, finalize, (object));
 }
@@ -268,8 +340,7 @@ gst_rmdemux_init (GstRMDemux * rmdemux)
   rmdemux->have_group_id = FALSE;
   rmdemux->group_id = G_MAXUINT;
   rmdemux->flowcombiner = gst_flow_combiner_new ();
-
-  gst_rm_utils_run_tests ();
+  rmdemux->seek_index = g_array_new (FALSE, FALSE, sizeof (GstRMDemuxIndex));
 }
 
 static gboolean
@@ -385,6 +456,8 @@ gst_rmdemux_validate_offset (GstRMDemux * rmdemux)
   gst_buffer_unmap (buffer, &map);
 
   if (ret) {
+    buffer = gst_buffer_make_writable (buffer);
+    GST_BUFFER_OFFSET (buffer) = rmdemux->offset;
     rmdemux->offset += 4;
     gst_adapter_clear (rmdemux->adapter);
     gst_adapter_push (rmdemux->adapter, buffer);
@@ -397,6 +470,107 @@ gst_rmdemux_validate_offset (GstRMDemux * rmdemux)
   return ret;
 }
 
+/* returns the last entry of @index at or before @time, or -1 */
+static gint
+gst_rmdemux_index_find_time (const GstRMDemuxIndex * index, gint length,
+    GstClockTime time)
+{
+  gint lo = 0, hi = length;
+
+  while (lo < hi) {
+    gint mid = lo + (hi - lo) / 2;
+
+    if (index[mid].timestamp <= time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/* returns the last entry of @index at or before @offset, or -1 */
+static gint
+gst_rmdemux_index_find_offset (const GstRMDemuxIndex * index, gint length,
+    guint32 offset)
+{
+  gint lo = 0, hi = length;
+
+  while (lo < hi) {
+    gint mid = lo + (hi - lo) / 2;
+
+    if (index[mid].offset <= offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+/* Merges the stream indices into one table giving the offset to seek to for
+ * a time: of the last entries of all streams at or before the time, the
+ * offset of the earliest one. That only changes at the timestamp of an
+ * index entry, so we walk the entries of all streams in timestamp order and
+ * record every change. */
+static void
+gst_rmdemux_build_seek_index (GstRMDemux * rmdemux)
+{
+  GstRMDemuxStream **streams;
+  gint *pos;
+  guint n_streams, i;
+  GSList *cur;
+
+  g_array_set_size (rmdemux->seek_index, 0);
+
+  n_streams = g_slist_length (rmdemux->streams);
+  streams = g_new (GstRMDemuxStream *, n_streams);
+  pos = g_new0 (gint, n_streams);
+  for (cur = rmdemux->streams, i = 0; cur; cur = cur->next, i++)
+    streams[i] = cur->data;
+
+  while (TRUE) {
+    GstRMDemuxIndex entry = { 0, };
+    GstClockTime earliest = GST_CLOCK_TIME_NONE;
+    gint next = -1;
+
+    /* take the next entry in timestamp order */
+    for (i = 0; i < n_streams; i++) {
+      if (pos[i] < streams[i]->index_length && (next == -1 ||
+              streams[i]->index[pos[i]].timestamp <
+              streams[next]->index[pos[next]].timestamp))
+        next = i;
+    }
+    if (next == -1)
+      break;
+    entry.timestamp = streams[next]->index[pos[next]].timestamp;
+    pos[next]++;
+
+    for (i = 0; i < n_streams; i++) {
+      GstRMDemuxIndex *last;
+
+      if (pos[i] == 0)
+        continue;
+      last = &streams[i]->index[pos[i] - 1];
+      if (earliest == GST_CLOCK_TIME_NONE || last->timestamp < earliest) {
+        earliest = last->timestamp;
+        entry.offset = last->offset;
+      }
+    }
+
+    if (rmdemux->seek_index->len > 0 &&
+        g_array_index (rmdemux->seek_index, GstRMDemuxIndex,
+            rmdemux->seek_index->len - 1).offset == entry.offset)
+      continue;
+
+    g_array_append_val (rmdemux->seek_index, entry);
+  }
+
+  GST_DEBUG_OBJECT (rmdemux, "built seek index of %u entries",
+      rmdemux->seek_index->len);
+
+  g_free (pos);
+  g_free (streams);
+}
+
 static gboolean
 find_seek_offset_bytes (GstRMDemux * rmdemux, guint target)
 {
@@ -407,17 +581,15 @@ find_seek_offset_bytes (GstRMDemux * rmdemux, guint target)
   for (cur = rmdemux->streams; cur; cur = cur->next) {
     GstRMDemuxStream *stream = cur->data;
 
-    /* Search backwards through this stream's index until we find the first
-     * timestamp before our target time */
-    for (i = stream->index_length - 1; i >= 0; i--) {
-      if (stream->index[i].offset <= target) {
-        /* Set the seek_offset for the stream so we don't bother parsing it
-         * until we've passed that point */
-        stream->seek_offset = stream->index[i].offset;
-        rmdemux->offset = stream->index[i].offset;
-        ret = TRUE;
-        break;
-      }
+    /* Find the last entry of this stream's index before our target offset */
+    i = gst_rmdemux_index_find_offset (stream->index, stream->index_length,
+        target);
+    if (i >= 0) {
+      /* Set the seek_offset for the stream so we don't bother parsing it
+       * until we've passed that point */
+      stream->seek_offset = stream->index[i].offset;
+      rmdemux->offset = stream->index[i].offset;
+      ret = TRUE;
     }
   }
   return ret;
@@ -426,45 +598,169 @@ find_seek_offset_bytes (GstRMDemux * rmdemux, guint target)
 static gboolean
 find_seek_offset_time (GstRMDemux * rmdemux, GstClockTime time)
 {
-  int i, n_stream;
-  gboolean ret = FALSE;
+  int i;
   GSList *cur;
-  GstClockTime earliest = GST_CLOCK_TIME_NONE;
+  GArray *seek_index = rmdemux->seek_index;
+  GstRMDemuxIndex *entry;
 
-  n_stream = 0;
-  for (cur = rmdemux->streams; cur; cur = cur->next, n_stream++) {
+  for (cur = rmdemux->streams; cur; cur = cur->next) {
     GstRMDemuxStream *stream = cur->data;
 
-    /* Search backwards through this stream's index until we find the first
-     * timestamp before our target time */
-    for (i = stream->index_length - 1; i >= 0; i--) {
-      if (stream->index[i].timestamp <= time) {
-        /* Set the seek_offset for the stream so we don't bother parsing it
-         * until we've passed that point */
-        stream->seek_offset = stream->index[i].offset;
-
-        /* If it's also the earliest timestamp we've seen of all streams, then
-         * that's our target!
-         */
-        if (earliest == GST_CLOCK_TIME_NONE ||
-            stream->index[i].timestamp < earliest) {
-          earliest = stream->index[i].timestamp;
-          rmdemux->offset = stream->index[i].offset;
-          GST_DEBUG_OBJECT (rmdemux,
-              "We're looking for %" GST_TIME_FORMAT
-              " and we found that stream %d has the latest index at %"
-              GST_TIME_FORMAT, GST_TIME_ARGS (rmdemux->segment.start), n_stream,
-              GST_TIME_ARGS (earliest));
-        }
+    /* Find the last entry of this stream's index before our target time */
+    i = gst_rmdemux_index_find_time (stream->index, stream->index_length, time);
+    if (i >= 0) {
+      /* Set the seek_offset for the stream so we don't bother parsing it
+       * until we've passed that point */
+      stream->seek_offset = stream->index[i].offset;
+    }
+    stream->discont = TRUE;
+  }
 
-        ret = TRUE;
+  /* the offset of the earliest of these entries is our target */
+  if (seek_index->len == 0)
+    gst_rmdemux_build_seek_index (rmdemux);
 
-        break;
+  i = gst_rmdemux_index_find_time ((GstRMDemuxIndex *) seek_index->data,
+      seek_index->len, time);
+  if (i < 0)
+    return FALSE;
+
+  entry = &g_array_index (seek_index, GstRMDemuxIndex, i);
+  rmdemux->offset = entry->offset;
+  GST_DEBUG_OBJECT (rmdemux, "We're looking for %" GST_TIME_FORMAT
+      " and found offset %u", GST_TIME_ARGS (time), entry->offset);
+
+  return TRUE;
+}
+
+/* copies @size bytes at @offset, pulling a new chunk into @chunk when they
+ * are not in the current one */
+static gboolean
+gst_rmdemux_scan_read (GstRMDemux * rmdemux, GstBuffer ** chunk,
+    guint32 * chunk_offset, guint32 offset, guint8 * dest, gsize size)
+{
+  if (*chunk == NULL || offset < *chunk_offset ||
+      offset + size > *chunk_offset + gst_buffer_get_size (*chunk)) {
+    gst_buffer_replace (chunk, NULL);
+    if (gst_pad_pull_range (rmdemux->sinkpad, offset, INDEX_SCAN_CHUNK_SIZE,
+            chunk) != GST_FLOW_OK)
+      return FALSE;
+    *chunk_offset = offset;
+  }
+  return gst_buffer_extract (*chunk, offset - *chunk_offset, dest,
+      size) == size;
+}
+
+/* adds a keyframe found in the data packets to the index of @stream, unless
+ * it is within INDEX_SCAN_INTERVAL of the last entry or not after it */
+static void
+gst_rmdemux_add_index_entry (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
+    GstClockTime timestamp, guint32 offset)
+{
+  GstRMDemuxIndex *last;
+
+  if (stream->index_length > 0) {
+    last = &stream->index[stream->index_length - 1];
+    if (offset <= last->offset ||
+        timestamp < last->timestamp + INDEX_SCAN_INTERVAL)
+      return;
+  }
+
+  GST_LOG_OBJECT (rmdemux, "stream %d: keyframe at %" GST_TIME_FORMAT
+      ", offset %u", stream->id, GST_TIME_ARGS (timestamp), offset);
+
+  stream->index = g_renew (GstRMDemuxIndex, stream->index,
+      stream->index_length + 1);
+  stream->index[stream->index_length].timestamp = timestamp;
+  stream->index[stream->index_length].offset = offset;
+  stream->index_length++;
+
+  /* the merged index needs to include this one */
+  g_array_set_size (rmdemux->seek_index, 0);
+}
+
+/* Completes the stream indices from the headers of the data packets, for
+ * files with a truncated or without INDX chunk. Only the packet headers are
+ * needed, so the data is read in big chunks and the payloads skipped.
+ * Keyframes become index entries like the ones of an INDX chunk, so seeks
+ * after this are exact.
+ *
+ * The scan starts after the last index entry of the streams, or where an
+ * earlier scan or playback stopped looking at the packets, and only goes as
+ * far as needed for a seek to @target. */
+static void
+gst_rmdemux_scan_index (GstRMDemux * rmdemux, GstClockTime target)
+{
+  GstBuffer *chunk = NULL;
+  guint32 chunk_offset = 0, offset, data_start;
+  GSList *cur;
+
+  if (rmdemux->first_data_offset == 0)
+    return;
+
+  data_start = rmdemux->first_data_offset + HEADER_SIZE + DATA_SIZE;
+  offset = G_MAXUINT32;
+  for (cur = rmdemux->streams; cur; cur = cur->next) {
+    GstRMDemuxStream *stream = cur->data;
+
+    if (stream->pad == NULL || (stream->subtype != GST_RMDEMUX_STREAM_VIDEO &&
+            stream->subtype != GST_RMDEMUX_STREAM_AUDIO))
+      continue;
+
+    if (stream->index_length > 0)
+      offset = MIN (offset, stream->index[stream->index_length - 1].offset);
+    else
+      offset = data_start;
+  }
+  if (offset == G_MAXUINT32)
+    return;
+  offset = MAX (offset, rmdemux->index_scan_offset);
+
+  GST_DEBUG_OBJECT (rmdemux, "scanning data packets from offset %u for %"
+      GST_TIME_FORMAT, offset, GST_TIME_ARGS (target));
+
+  while (TRUE) {
+    guint8 header[PACKET_HEADER_SIZE];
+    guint16 version, length, id;
+    GstClockTime timestamp;
+    GstRMDemuxStream *stream;
+
+    if (!gst_rmdemux_scan_read (rmdemux, &chunk, &chunk_offset, offset,
+            header, PACKET_HEADER_SIZE))
+      break;
+
+    version = RMDEMUX_GUINT16_GET (header);
+    if (version != 0 && version != 1) {
+      /* the data can continue in another DATA chunk */
+      if (RMDEMUX_FOURCC_GET (header) == GST_MAKE_FOURCC ('D', 'A', 'T', 'A')) {
+        offset += HEADER_SIZE + DATA_SIZE;
+        continue;
       }
+      break;
     }
-    stream->discont = TRUE;
+    length = RMDEMUX_GUINT16_GET (header + 2);
+    if (length < PACKET_HEADER_SIZE)
+      break;
+
+    id = RMDEMUX_GUINT16_GET (header + 4);
+    timestamp = RMDEMUX_GUINT32_GET (header + 6) * GST_MSECOND;
+    if (GST_CLOCK_TIME_IS_VALID (target) &&
+        timestamp > target + INDEX_SCAN_AHEAD)
+      break;
+
+    /* only keyframes are places to start from */
+    stream = gst_rmdemux_get_stream_by_id (rmdemux, id);
+    if ((header[11] & 0x02) != 0 && stream != NULL && stream->pad != NULL &&
+        (stream->subtype == GST_RMDEMUX_STREAM_VIDEO ||
+            stream->subtype == GST_RMDEMUX_STREAM_AUDIO))
+      gst_rmdemux_add_index_entry (rmdemux, stream, timestamp, offset);
+
+    offset += length;
   }
-  return ret;
+  gst_buffer_replace (&chunk, NULL);
+
+  if (offset > rmdemux->index_scan_offset)
+    rmdemux->index_scan_offset = offset;
 }
 
 static gboolean
@@ -553,6 +849,8 @@ gst_rmdemux_perform_seek (GstRMDemux * rmdemux, GstEvent * event)
    * offset we just tried. If we run out of places to try, treat that as a fatal
    * error.
    */
+  gst_rmdemux_scan_index (rmdemux, rmdemux->segment.position);
+
   if (!find_seek_offset_time (rmdemux, rmdemux->segment.position)) {
     GST_LOG_OBJECT (rmdemux, "Failed to find seek offset by time");
     ret = FALSE;
@@ -681,15 +979,149 @@ gst_rmdemux_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
   return res;
 }
 
+static GstBufferPool *
+gst_rmdemux_create_pool (GstRMDemux * rmdemux, guint size)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+
+  pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, NULL, size, 0,
+      GST_RMDEMUX_POOL_MAX_BUFFERS);
+
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE)) {
+    GST_WARNING_OBJECT (rmdemux, "failed to set up pool for %u bytes", size);
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (rmdemux, "created pool for buffers of %u bytes", size);
+  return pool;
+}
+
+static GstBuffer *
+gst_rmdemux_acquire_buffer (GstBufferPool * pool, gsize size)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstBuffer *buf = NULL;
+
+  /* rather allocate than wait for downstream to release a buffer */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  if (gst_buffer_pool_acquire_buffer (pool, &buf, &params) != GST_FLOW_OK)
+    return NULL;
+
+  gst_buffer_set_size (buf, size);
+  return buf;
+}
+
+/* returns a buffer of @size bytes from the downstream pool of @stream or from
+ * a pool for the next power of two. Only use this for buffers that are pushed
+ * as a whole, the memory of buffers that were split up can't be reused. */
+static GstBuffer *
+gst_rmdemux_alloc_buffer (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
+    gsize size)
+{
+  GstBuffer *buf;
+  guint shift, n;
+
+  if (stream->pool != NULL && size <= stream->pool_size) {
+    buf = gst_rmdemux_acquire_buffer (stream->pool, size);
+    if (buf != NULL) {
+      g_atomic_int_inc (&rmdemux->stat_buffers_downstream);
+      return buf;
+    }
+  }
+
+  shift = (size > 1) ? g_bit_storage (size - 1) : 0;
+  shift = MAX (shift, GST_RMDEMUX_POOL_MIN_SHIFT);
+  n = shift - GST_RMDEMUX_POOL_MIN_SHIFT;
+
+  if (n < GST_RMDEMUX_NUM_POOLS) {
+    if (G_UNLIKELY (rmdemux->pools[n] == NULL))
+      rmdemux->pools[n] = gst_rmdemux_create_pool (rmdemux, 1 << shift);
+
+    if (rmdemux->pools[n] != NULL) {
+      buf = gst_rmdemux_acquire_buffer (rmdemux->pools[n], size);
+      if (buf != NULL) {
+        g_atomic_int_inc (&rmdemux->stat_buffers_pooled);
+        return buf;
+      }
+    }
+  }
+
+  g_atomic_int_inc (&rmdemux->stat_buffers_allocated);
+  return gst_buffer_new_allocate (NULL, size, NULL);
+}
+
+static void
+gst_rmdemux_free_pools (GstRMDemux * rmdemux)
+{
+  guint i;
+
+  for (i = 0; i < GST_RMDEMUX_NUM_POOLS; ++i) {
+    if (rmdemux->pools[i] != NULL) {
+      gst_buffer_pool_set_active (rmdemux->pools[i], FALSE);
+      gst_object_unref (rmdemux->pools[i]);
+      rmdemux->pools[i] = NULL;
+    }
+  }
+}
+
+/* use the pool downstream proposes for buffers we have to allocate */
+static void
+gst_rmdemux_stream_query_allocation (GstRMDemux * rmdemux,
+    GstRMDemuxStream * stream, GstCaps * caps)
+{
+  GstBufferPool *pool = NULL;
+  GstStructure *config;
+  GstQuery *query;
+  guint size = 0, min = 0, max = 0;
+
+  query = gst_query_new_allocation (caps, TRUE);
+  if (gst_pad_peer_query (stream->pad, query) &&
+      gst_query_get_n_allocation_pools (query) > 0)
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+  gst_query_unref (query);
+
+  if (pool == NULL || size == 0)
+    goto no_pool;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE))
+    goto no_pool;
+
+  GST_DEBUG_OBJECT (stream->pad, "using downstream pool for buffers of up "
+      "to %u bytes", size);
+  stream->pool = pool;
+  stream->pool_size = size;
+  return;
+
+no_pool:
+  {
+    if (pool)
+      gst_object_unref (pool);
+    return;
+  }
+}
+
 static void
 gst_rmdemux_free_stream (GstRMDemux * rmdemux, GstRMDemuxStream * stream)
 {
   g_object_unref (stream->adapter);
+  if (stream->pool) {
+    gst_buffer_pool_set_active (stream->pool, FALSE);
+    gst_object_unref (stream->pool);
+  }
   gst_rmdemux_stream_clear_cached_subpackets (rmdemux, stream);
   if (stream->pending_tags)
     gst_tag_list_unref (stream->pending_tags);
   if (stream->subpackets)
     g_ptr_array_free (stream->subpackets, TRUE);
+  g_free (stream->leaf_perm);
   g_free (stream->index);
   g_free (stream);
 }
@@ -712,8 +1144,12 @@ gst_rmdemux_reset (GstRMDemux * rmdemux)
   }
   g_slist_free (rmdemux->streams);
   rmdemux->streams = NULL;
+  g_array_set_size (rmdemux->seek_index, 0);
+  rmdemux->index_scan_offset = 0;
+  rmdemux->first_data_offset = 0;
   rmdemux->n_audio_streams = 0;
   rmdemux->n_video_streams = 0;
+  gst_rmdemux_free_pools (rmdemux);
 
   if (rmdemux->pending_tags != NULL) {
     gst_tag_list_unref (rmdemux->pending_tags);
@@ -763,8 +1199,6 @@ gst_rmdemux_change_state (GstElement * element, GstStateChange transition)
       gst_rmdemux_reset (rmdemux);
       break;
     }
-    case GST_STATE_CHANGE_READY_TO_NULL:
-      break;
     default:
       break;
   }
@@ -882,12 +1316,12 @@ gst_rmdemux_loop (GstPad * pad)
   ret = gst_pad_pull_range (pad, rmdemux->offset, size, &buffer);
   if (ret != GST_FLOW_OK) {
     if (rmdemux->offset == rmdemux->index_offset) {
-      /* The index isn't available so forget about it */
+      /* The index isn't available so forget about it, we build one from the
+       * data packets when seeking */
       rmdemux->loop_state = RMDEMUX_LOOP_STATE_DATA;
       rmdemux->offset = rmdemux->data_offset;
       GST_OBJECT_LOCK (rmdemux);
       rmdemux->running = TRUE;
-      rmdemux->seekable = FALSE;
       GST_OBJECT_UNLOCK (rmdemux);
       return;
     } else {
@@ -899,6 +1333,8 @@ gst_rmdemux_loop (GstPad * pad)
   }
 
   size = gst_buffer_get_size (buffer);
+  buffer = gst_buffer_make_writable (buffer);
+  GST_BUFFER_OFFSET (buffer) = rmdemux->offset;
 
   /* Defer to the chain function */
   ret = gst_rmdemux_chain (pad, GST_OBJECT_CAST (rmdemux), buffer);
@@ -1228,6 +1664,7 @@ gst_rmdemux_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
             gst_adapter_flush (rmdemux->adapter, 4);
           } else {
             GstBuffer *buffer;
+            guint64 offset, distance;
 
             avail = gst_adapter_available (rmdemux->adapter);
             if (avail < length)
@@ -1236,11 +1673,18 @@ gst_rmdemux_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
             GST_LOG_OBJECT (rmdemux, "we have %u available and we needed %d",
                 avail, length);
 
+            /* the offset of the packet in the file, if upstream told us */
+            offset = gst_adapter_prev_offset (rmdemux->adapter, &distance);
+            if (offset != GST_BUFFER_OFFSET_NONE)
+              offset += distance;
+
             /* flush version and length */
             gst_adapter_flush (rmdemux->adapter, 4);
             length -= 4;
 
             buffer = gst_adapter_take_buffer (rmdemux->adapter, length);
+            buffer = gst_buffer_make_writable (buffer);
+            GST_BUFFER_OFFSET (buffer) = offset;
 
             ret = gst_rmdemux_parse_packet (rmdemux, buffer, version);
             rmdemux->chunk_index++;
@@ -1571,6 +2015,8 @@ gst_rmdemux_add_stream (GstRMDemux * rmdemux, GstRMDemuxStream * stream)
     }
     gst_element_add_pad (GST_ELEMENT_CAST (rmdemux), stream->pad);
     gst_flow_combiner_add_pad (rmdemux->flowcombiner, stream->pad);
+
+    gst_rmdemux_stream_query_allocation (rmdemux, stream, stream_caps);
   }
 
 beach:
@@ -1616,6 +2062,10 @@ gst_rmdemux_parse_prop (GstRMDemux * rmdemux, const guint8 * data, int length)
   GST_LOG_OBJECT (rmdemux, "offset of INDX section: 0x%08x",
       rmdemux->index_offset);
   rmdemux->data_offset = RMDEMUX_GUINT32_GET (data + 32);
+  rmdemux->first_data_offset = rmdemux->data_offset;
+  if (rmdemux->data_offset != 0)
+    rmdemux->index_scan_offset = rmdemux->data_offset + HEADER_SIZE +
+        DATA_SIZE;
   GST_LOG_OBJECT (rmdemux, "offset of DATA section: 0x%08x",
       rmdemux->data_offset);
   GST_LOG_OBJECT (rmdemux, "n streams: %d", RMDEMUX_GUINT16_GET (data + 36));
@@ -1882,7 +2332,7 @@ static void
 gst_rmdemux_parse_indx_data (GstRMDemux * rmdemux, const guint8 * data,
     int length)
 {
-  int i;
+  int i, j;
   int n;
   GstRMDemuxIndex *index;
 
@@ -1900,18 +2350,31 @@ gst_rmdemux_parse_indx_data (GstRMDemux * rmdemux, const guint8 * data,
   }
 
   index = g_malloc (sizeof (GstRMDemuxIndex) * n);
-  rmdemux->index_stream->index = index;
-  rmdemux->index_stream->index_length = n;
 
-  for (i = 0; i < n; i++) {
-    index[i].timestamp = RMDEMUX_GUINT32_GET (data + 2) * GST_MSECOND;
-    index[i].offset = RMDEMUX_GUINT32_GET (data + 6);
+  /* entries are searched by both timestamp and offset, so only keep the ones
+   * that go forward in both */
+  for (i = 0, j = 0; i < n; i++, data += 14) {
+    GstClockTime timestamp = RMDEMUX_GUINT32_GET (data + 2) * GST_MSECOND;
+    guint32 offset = RMDEMUX_GUINT32_GET (data + 6);
 
     GST_DEBUG_OBJECT (rmdemux, "Index found for timestamp=%f (at offset=%x)",
-        gst_guint64_to_gdouble (index[i].timestamp) / GST_SECOND,
-        index[i].offset);
-    data += 14;
+        gst_guint64_to_gdouble (timestamp) / GST_SECOND, offset);
+
+    if (j > 0 && (timestamp < index[j - 1].timestamp ||
+            offset < index[j - 1].offset)) {
+      GST_WARNING_OBJECT (rmdemux, "Skipping out of order index entry");
+      continue;
+    }
+    index[j].timestamp = timestamp;
+    index[j].offset = offset;
+    j++;
   }
+
+  rmdemux->index_stream->index = index;
+  rmdemux->index_stream->index_length = j;
+
+  /* the merged index needs to include this one */
+  g_array_set_size (rmdemux->seek_index, 0);
 }
 
 static void
@@ -1960,73 +2423,143 @@ gst_rmdemux_stream_clear_cached_subpackets (GstRMDemux * rmdemux,
   g_ptr_array_set_size (stream->subpackets, 0);
 }
 
+/* the leaf order only depends on the height, packet size and leaf size of the
+ * stream, so compute it once and keep it around */
+static gboolean
+gst_rmdemux_descramble_update_perm (GstRMDemux * rmdemux,
+    GstRMDemuxStream * stream)
+{
+  guint height = stream->height;
+  guint leaves_per_packet, num_leaves;
+  guint p, x;
+
+  if (G_UNLIKELY (stream->leaf_size == 0 ||
+          stream->leaf_size > stream->packet_size)) {
+    GST_WARNING_OBJECT (rmdemux, "can't descramble packets of %u bytes with "
+        "leaf size %u", stream->packet_size, stream->leaf_size);
+    return FALSE;
+  }
+
+  leaves_per_packet = stream->packet_size / stream->leaf_size;
+  num_leaves = height * leaves_per_packet;
+
+  /* the number of leaves alone is not enough, eg. 2x4 and 4x2 leaves need
+   * different tables */
+  if (stream->leaf_perm != NULL && stream->leaf_perm_height == height &&
+      stream->leaf_perm_packet_size == stream->packet_size &&
+      stream->leaf_perm_leaf_size == stream->leaf_size)
+    return TRUE;
+
+  g_free (stream->leaf_perm);
+  stream->leaf_perm = g_new (guint, num_leaves);
+  stream->leaf_perm_height = height;
+  stream->leaf_perm_packet_size = stream->packet_size;
+  stream->leaf_perm_leaf_size = stream->leaf_size;
+
+  for (p = 0; p < height; ++p) {
+    for (x = 0; x < leaves_per_packet; ++x) {
+      guint idx;
+
+      idx = height * x + ((height + 1) / 2) * (p % 2) + (p / 2);
+      stream->leaf_perm[idx] = p * leaves_per_packet + x;
+    }
+  }
+
+  GST_DEBUG_OBJECT (rmdemux, "descrambling table for %u leaves of %u bytes, "
+      "height=%u, packet_size=%u", num_leaves, stream->leaf_size, height,
+      stream->packet_size);
+
+  return TRUE;
+}
+
 static GstFlowReturn
 gst_rmdemux_descramble_audio (GstRMDemux * rmdemux, GstRMDemuxStream * stream)
 {
-  GstFlowReturn ret = GST_FLOW_ERROR;
-  GstBuffer *outbuf;
-  GstMapInfo outmap;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo *maps;
   guint packet_size = stream->packet_size;
   guint height = stream->subpackets->len;
   guint leaf_size = stream->leaf_size;
-  guint p, x;
+  guint leaves_per_packet;
+  guint p, x, mapped;
 
   g_assert (stream->height == height);
 
   GST_LOG ("packet_size = %u, leaf_size = %u, height= %u", packet_size,
       leaf_size, height);
 
-  outbuf = gst_buffer_new_and_alloc (height * packet_size);
-  gst_buffer_map (outbuf, &outmap, GST_MAP_WRITE);
+  if (!gst_rmdemux_descramble_update_perm (rmdemux, stream))
+    goto done;
 
-  for (p = 0; p < height; ++p) {
-    GstBuffer *b = g_ptr_array_index (stream->subpackets, p);
-    GstMapInfo map;
+  leaves_per_packet = packet_size / leaf_size;
 
-    gst_buffer_map (b, &map, GST_MAP_READ);
+  maps = g_new (GstMapInfo, height);
+  for (mapped = 0; mapped < height; ++mapped) {
+    GstBuffer *b = g_ptr_array_index (stream->subpackets, mapped);
 
-    if (p == 0) {
-      GST_BUFFER_PTS (outbuf) = GST_BUFFER_PTS (b);
-      GST_BUFFER_DTS (outbuf) = GST_BUFFER_DTS (b);
+    gst_buffer_map (b, &maps[mapped], GST_MAP_READ);
+    if (G_UNLIKELY (maps[mapped].size < packet_size)) {
+      GST_WARNING_OBJECT (rmdemux, "subpacket %u too small (%" G_GSIZE_FORMAT
+          " < %u), discarding", mapped, maps[mapped].size, packet_size);
+      gst_buffer_unmap (b, &maps[mapped]);
+      goto unmap;
     }
+  }
 
-    for (x = 0; x < packet_size / leaf_size; ++x) {
-      guint idx;
+  /* some decoders, such as realaudiodec, need to be fed in packet units, so
+   * gather the leaves of each packet straight into its own buffer */
+  for (p = 0; p < height; ++p) {
+    GstBuffer *outbuf;
+    GstMapInfo outmap;
+    const guint *perm = stream->leaf_perm + p * leaves_per_packet;
 
-      idx = height * x + ((height + 1) / 2) * (p % 2) + (p / 2);
+    outbuf = gst_rmdemux_alloc_buffer (rmdemux, stream, packet_size);
+    gst_buffer_map (outbuf, &outmap, GST_MAP_WRITE);
+
+    /* leaves are tens to hundreds of bytes, memcpy does better on those
+     * than copying in vector sized steps */
+    for (x = 0; x < leaves_per_packet; ++x) {
+      guint src = perm[x];
 
-      /* GST_LOG ("%3u => %3u", (height * p) + x, idx); */
-      memcpy (outmap.data + leaf_size * idx, map.data + leaf_size * x,
-          leaf_size);
+      memcpy (outmap.data + leaf_size * x,
+          maps[src / leaves_per_packet].data +
+          leaf_size * (src % leaves_per_packet), leaf_size);
     }
-    gst_buffer_unmap (b, &map);
-  }
-  gst_buffer_unmap (outbuf, &outmap);
+    if (leaf_size * leaves_per_packet < packet_size)
+      memset (outmap.data + leaf_size * leaves_per_packet, 0,
+          packet_size - leaf_size * leaves_per_packet);
+    gst_buffer_unmap (outbuf, &outmap);
 
-  /* some decoders, such as realaudiodec, need to be fed in packet units */
-  for (p = 0; p < height; ++p) {
-    GstBuffer *subbuf;
+    if (p == 0) {
+      GstBuffer *b = g_ptr_array_index (stream->subpackets, 0);
 
-    subbuf =
-        gst_buffer_copy_region (outbuf, GST_BUFFER_COPY_ALL, p * packet_size,
-        packet_size);
+      GST_BUFFER_PTS (outbuf) = GST_BUFFER_PTS (b);
+      GST_BUFFER_DTS (outbuf) = GST_BUFFER_DTS (b);
+    }
 
     GST_LOG_OBJECT (rmdemux, "pushing buffer dts %" GST_TIME_FORMAT ", pts %"
-        GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_DTS (subbuf)),
-        GST_TIME_ARGS (GST_BUFFER_PTS (subbuf)));
+        GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_DTS (outbuf)),
+        GST_TIME_ARGS (GST_BUFFER_PTS (outbuf)));
 
     if (stream->discont) {
-      GST_BUFFER_FLAG_SET (subbuf, GST_BUFFER_FLAG_DISCONT);
+      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
       stream->discont = FALSE;
     }
 
-    ret = gst_pad_push (stream->pad, subbuf);
+    ret = gst_pad_push (stream->pad, outbuf);
     if (ret != GST_FLOW_OK)
       break;
   }
 
-  gst_buffer_unref (outbuf);
+unmap:
+  while (mapped > 0) {
+    --mapped;
+    gst_buffer_unmap (g_ptr_array_index (stream->subpackets, mapped),
+        &maps[mapped]);
+  }
+  g_free (maps);
 
+done:
   gst_rmdemux_stream_clear_cached_subpackets (rmdemux, stream);
 
   return ret;
@@ -2113,7 +2646,7 @@ gst_rmdemux_descramble_sipr_audio (GstRMDemux * rmdemux,
   GST_LOG ("packet_size = %u, leaf_size = %u, height= %u", packet_size,
       stream->leaf_size, height);
 
-  outbuf = gst_buffer_new_and_alloc (height * packet_size);
+  outbuf = gst_rmdemux_alloc_buffer (rmdemux, stream, height * packet_size);
   gst_buffer_map (outbuf, &outmap, GST_MAP_WRITE);
 
   for (p = 0; p < height; ++p) {
@@ -2325,6 +2858,7 @@ gst_rmdemux_parse_video_packet (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
       GstMapInfo outmap;
       guint8 *outdata;
       guint header_size;
+      gboolean copy;
       gint i, avail;
 
       /* calculate header size, which is:
@@ -2345,7 +2879,15 @@ gst_rmdemux_parse_video_packet (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
 
       avail = gst_adapter_available (stream->adapter);
 
-      out = gst_buffer_new_and_alloc (header_size + avail);
+      /* the fragments share the memory of the input packets and are appended
+       * to the header instead of being copied. A buffer only holds so many
+       * memories though and merges them again on every append past that, so
+       * frames with more fragments are copied into one buffer. */
+      copy = stream->frag_count >= gst_buffer_get_max_memory ();
+      if (copy)
+        out = gst_rmdemux_alloc_buffer (rmdemux, stream, header_size + avail);
+      else
+        out = gst_buffer_new_allocate (NULL, header_size, NULL);
       gst_buffer_map (out, &outmap, GST_MAP_WRITE);
       outdata = outmap.data;
 
@@ -2357,10 +2899,15 @@ gst_rmdemux_parse_video_packet (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
         GST_WRITE_UINT32_LE (outdata, stream->frag_offset[i]);
         outdata += 4;
       }
+      if (copy) {
+        gst_adapter_copy (stream->adapter, outdata, 0, avail);
+        gst_adapter_flush (stream->adapter, avail);
+      }
+      gst_buffer_unmap (out, &outmap);
 
-      /* copy packet data after the header now */
-      gst_adapter_copy (stream->adapter, outdata, 0, avail);
-      gst_adapter_flush (stream->adapter, avail);
+      if (!copy && avail > 0)
+        out = gst_buffer_append (out,
+            gst_adapter_take_buffer_fast (stream->adapter, avail));
 
       stream->frag_current = 0;
       stream->frag_count = 0;
@@ -2375,7 +2922,6 @@ gst_rmdemux_parse_video_packet (GstRMDemux * rmdemux, GstRMDemuxStream * stream,
         if (rmdemux->base_ts != -1)
           timestamp += rmdemux->base_ts;
       }
-      gst_buffer_unmap (out, &outmap);
 
       /* video has DTS */
       GST_BUFFER_DTS (out) = timestamp;
@@ -2485,11 +3031,19 @@ gst_rmdemux_parse_packet (GstRMDemux * rmdemux, GstBuffer * in, guint16 version)
   guint8 *data;
   guint8 flags;
   guint32 ts;
+  gboolean learn;
 
   gst_buffer_map (in, &map, GST_MAP_READ);
   data = map.data;
   size = map.size;
 
+  /* learn the keyframes while playing the part of the file a seek would
+   * otherwise have to scan; the version and length were taken off already */
+  learn = rmdemux->index_scan_offset != 0 &&
+      GST_BUFFER_OFFSET (in) == rmdemux->index_scan_offset;
+  if (learn)
+    rmdemux->index_scan_offset += size + 4;
+
   /* stream number */
   id = RMDEMUX_GUINT16_GET (data);
 
@@ -2534,6 +3088,11 @@ gst_rmdemux_parse_packet (GstRMDemux * rmdemux, GstBuffer * in, guint16 version)
   key = (flags & 0x02) != 0;
   GST_DEBUG_OBJECT (rmdemux, "flags %d, Keyframe %d", flags, key);
 
+  if (learn && key && (stream->subtype == GST_RMDEMUX_STREAM_VIDEO ||
+          stream->subtype == GST_RMDEMUX_STREAM_AUDIO))
+    gst_rmdemux_add_index_entry (rmdemux, stream, timestamp,
+        GST_BUFFER_OFFSET (in));
+
   if (rmdemux->need_newsegment) {
     GstEvent *event;
 
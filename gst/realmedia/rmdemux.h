@@ -73,6 +73,12 @@ typedef enum
   GST_RMDEMUX_STREAM_FILEINFO
 } GstRMDemuxStreamType;
 
+/* output buffers are taken from pools for sizes of 2^10 to 2^20 bytes,
+ * with at most GST_RMDEMUX_POOL_MAX_BUFFERS buffers each */
+#define GST_RMDEMUX_POOL_MIN_SHIFT   10
+#define GST_RMDEMUX_NUM_POOLS        11
+#define GST_RMDEMUX_POOL_MAX_BUFFERS 16
+
 typedef struct _GstRMDemux GstRMDemux;
 typedef struct _GstRMDemuxClass GstRMDemuxClass;
 typedef struct _GstRMDemuxStream GstRMDemuxStream;
@@ -99,6 +105,7 @@ struct _GstRMDemux {
   guint32 avg_packet_size;
   guint32 index_offset;
   guint32 data_offset;
+  guint32 first_data_offset;
   guint32 num_packets;
 
   guint offset;
@@ -107,6 +114,12 @@ struct _GstRMDemux {
   GstRMDemuxState state;
   GstRMDemuxLoopState loop_state;
   GstRMDemuxStream *index_stream;
+  /* the seek offsets of all streams merged, sorted by timestamp, built from
+   * the stream indices on the first seek */
+  GArray *seek_index;
+  /* the data packets up to this offset were looked at for keyframes to
+   * complete the stream indices with, by a scan or while playing */
+  guint32 index_scan_offset;
 
   /* playback start/stop positions */
   GstSegment segment;
@@ -132,6 +145,13 @@ struct _GstRMDemux {
 
   /* container tags for all streams */
   GstTagList *pending_tags;
+
+  GstBufferPool *pools[GST_RMDEMUX_NUM_POOLS];
+
+  /* statistics, updated atomically */
+  gint stat_buffers_allocated;
+  gint stat_buffers_pooled;
+  gint stat_buffers_downstream;
 };
 
 struct _GstRMDemuxClass {
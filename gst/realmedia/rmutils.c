@@ -122,39 +122,301 @@ gst_rm_utils_read_tags (const guint8 * data, guint datalen,
   return NULL;
 }
 
+/* the dnet byte swapping and the sipr nibble block swapping have SIMD
+ * versions, the fastest one the CPU supports is picked once, in
+ * gst_rm_utils_get_kernels() */
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define RM_UTILS_HAVE_X86 1
+#include <immintrin.h>
+#define RM_UTILS_TARGET(t) __attribute__ ((target (t)))
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+#define RM_UTILS_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct
+{
+  /* swaps the bytes of each 16-bit word in @data, an odd last byte is left
+   * alone */
+  void (*swap_bytes) (guint8 * data, gsize len);
+  /* exchanges @len bytes of @a and @b, which must not overlap */
+  void (*swap_blocks) (guint8 * a, guint8 * b, guint len);
+  /* moves the 2 * @len nibbles starting at the high nibble of @d1[0] to
+   * @d2 and the ones of @d2 to @d1, one nibble later; the low nibble of
+   * @d1[0] is set to the high nibble of @prev. The low nibble of @d1[@len]
+   * is read but not written */
+  void (*swap_shifted) (guint8 * d1, guint8 * d2, guint len, guint8 prev);
+} GstRMUtilsKernels;
+
+static void
+gst_rm_utils_swap_bytes_c (guint8 * data, gsize len)
+{
+  gsize i = 0;
+  guint8 tmp;
+
+  /* byte-swap 4 words at a time, the masks select the same bytes whatever
+   * the host endianness */
+  for (; i + sizeof (guint64) <= len; i += sizeof (guint64)) {
+    guint64 w;
+
+    memcpy (&w, data + i, sizeof (guint64));
+    w = ((w & G_GUINT64_CONSTANT (0x00ff00ff00ff00ff)) << 8) |
+        ((w >> 8) & G_GUINT64_CONSTANT (0x00ff00ff00ff00ff));
+    memcpy (data + i, &w, sizeof (guint64));
+  }
+  for (; i + 1 < len; i += sizeof (guint16)) {
+    /* byte-swap */
+    tmp = data[i];
+    data[i] = data[i + 1];
+    data[i + 1] = tmp;
+  }
+}
+
+static void
+gst_rm_utils_swap_blocks_c (guint8 * a, guint8 * b, guint len)
+{
+  guint i = 0;
+  guint8 tmp;
+
+  for (; i + sizeof (guint64) <= len; i += sizeof (guint64)) {
+    guint64 wa, wb;
+
+    memcpy (&wa, a + i, sizeof (guint64));
+    memcpy (&wb, b + i, sizeof (guint64));
+    memcpy (a + i, &wb, sizeof (guint64));
+    memcpy (b + i, &wa, sizeof (guint64));
+  }
+  for (; i < len; i++) {
+    tmp = a[i];
+    a[i] = b[i];
+    b[i] = tmp;
+  }
+}
+
+static void
+gst_rm_utils_swap_shifted_c (guint8 * d1, guint8 * d2, guint len, guint8 prev)
+{
+  guint i = 0;
+  guint8 tmp;
+
+  /* shifting little endian words by 4 bits moves the nibbles across bytes,
+   * @d1 is shifted down and @d2 up */
+  for (; i + sizeof (guint64) <= len; i += sizeof (guint64)) {
+    guint64 w1, w2;
+
+    w1 = GST_READ_UINT64_LE (d1 + i) >> 4;
+    w1 |= (guint64) d1[i + sizeof (guint64)] << 60;
+    w2 = GST_READ_UINT64_LE (d2 + i);
+    GST_WRITE_UINT64_LE (d1 + i, (w2 << 4) | (prev >> 4));
+    GST_WRITE_UINT64_LE (d2 + i, w1);
+    prev = w2 >> 56;
+  }
+  for (; i < len; i++) {
+    tmp = d2[i];
+    d2[i] = (d1[i] >> 4) | (d1[i + 1] << 4);
+    d1[i] = (tmp << 4) | (prev >> 4);
+    prev = tmp;
+  }
+}
+
+#ifdef RM_UTILS_HAVE_X86
+/* x86 is little endian, so shifting 16-bit lanes by 8 swaps their bytes */
+static RM_UTILS_TARGET ("sse2") void
+gst_rm_utils_swap_bytes_sse2 (guint8 * data, gsize len)
+{
+  gsize i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+
+    v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+    _mm_storeu_si128 ((__m128i *) (data + i), v);
+  }
+  gst_rm_utils_swap_bytes_c (data + i, len - i);
+}
+
+static RM_UTILS_TARGET ("avx2") void
+gst_rm_utils_swap_bytes_avx2 (guint8 * data, gsize len)
+{
+  gsize i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) (data + i));
+
+    v = _mm256_or_si256 (_mm256_slli_epi16 (v, 8), _mm256_srli_epi16 (v, 8));
+    _mm256_storeu_si256 ((__m256i *) (data + i), v);
+  }
+  gst_rm_utils_swap_bytes_sse2 (data + i, len - i);
+}
+
+static RM_UTILS_TARGET ("sse2") void
+gst_rm_utils_swap_blocks_sse2 (guint8 * a, guint8 * b, guint len)
+{
+  guint i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i va = _mm_loadu_si128 ((const __m128i *) (a + i));
+    __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + i));
+
+    _mm_storeu_si128 ((__m128i *) (a + i), vb);
+    _mm_storeu_si128 ((__m128i *) (b + i), va);
+  }
+  gst_rm_utils_swap_blocks_c (a + i, b + i, len - i);
+}
+
+/* there are no byte shifts, so shift 16-bit lanes and mask off the bits
+ * that crossed into the other byte */
+static RM_UTILS_TARGET ("sse2") void
+gst_rm_utils_swap_shifted_sse2 (guint8 * d1, guint8 * d2, guint len,
+    guint8 prev)
+{
+  const __m128i lo = _mm_set1_epi8 (0x0f);
+  const __m128i hi = _mm_set1_epi8 ((gchar) 0xf0);
+  __m128i p = _mm_slli_si128 (_mm_cvtsi32_si128 (prev), 15);
+  guint i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (d1 + i));
+    __m128i a1 = _mm_loadu_si128 ((const __m128i *) (d1 + i + 1));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (d2 + i));
+    /* the bytes of @d2 one position before the ones in b */
+    __m128i b1 = _mm_or_si128 (_mm_slli_si128 (b, 1), _mm_srli_si128 (p, 15));
+
+    a = _mm_or_si128 (_mm_and_si128 (_mm_srli_epi16 (a, 4), lo),
+        _mm_and_si128 (_mm_slli_epi16 (a1, 4), hi));
+    b1 = _mm_or_si128 (_mm_and_si128 (_mm_srli_epi16 (b1, 4), lo),
+        _mm_and_si128 (_mm_slli_epi16 (b, 4), hi));
+    _mm_storeu_si128 ((__m128i *) (d1 + i), b1);
+    _mm_storeu_si128 ((__m128i *) (d2 + i), a);
+    p = b;
+  }
+  if (i > 0)
+    prev = _mm_cvtsi128_si32 (_mm_srli_si128 (p, 15));
+  gst_rm_utils_swap_shifted_c (d1 + i, d2 + i, len - i, prev);
+}
+#endif
+
+#ifdef RM_UTILS_HAVE_NEON
+static void
+gst_rm_utils_swap_bytes_neon (guint8 * data, gsize len)
+{
+  gsize i = 0;
+
+  for (; i + 16 <= len; i += 16)
+    vst1q_u8 (data + i, vrev16q_u8 (vld1q_u8 (data + i)));
+  gst_rm_utils_swap_bytes_c (data + i, len - i);
+}
+
+static void
+gst_rm_utils_swap_blocks_neon (guint8 * a, guint8 * b, guint len)
+{
+  guint i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t va = vld1q_u8 (a + i);
+    uint8x16_t vb = vld1q_u8 (b + i);
+
+    vst1q_u8 (a + i, vb);
+    vst1q_u8 (b + i, va);
+  }
+  gst_rm_utils_swap_blocks_c (a + i, b + i, len - i);
+}
+
+static void
+gst_rm_utils_swap_shifted_neon (guint8 * d1, guint8 * d2, guint len,
+    guint8 prev)
+{
+  uint8x16_t p = vdupq_n_u8 (prev);
+  guint i = 0;
+
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t a = vld1q_u8 (d1 + i);
+    uint8x16_t a1 = vld1q_u8 (d1 + i + 1);
+    uint8x16_t b = vld1q_u8 (d2 + i);
+    /* the bytes of @d2 one position before the ones in b */
+    uint8x16_t b1 = vextq_u8 (p, b, 15);
+
+    vst1q_u8 (d1 + i, vorrq_u8 (vshrq_n_u8 (b1, 4), vshlq_n_u8 (b, 4)));
+    vst1q_u8 (d2 + i, vorrq_u8 (vshrq_n_u8 (a, 4), vshlq_n_u8 (a1, 4)));
+    p = b;
+  }
+  if (i > 0)
+    prev = vgetq_lane_u8 (p, 15);
+  gst_rm_utils_swap_shifted_c (d1 + i, d2 + i, len - i, prev);
+}
+#endif
+
+static gpointer
+gst_rm_utils_init_kernels (gpointer data)
+{
+  GstRMUtilsKernels *k = data;
+
+  k->swap_bytes = gst_rm_utils_swap_bytes_c;
+  k->swap_blocks = gst_rm_utils_swap_blocks_c;
+  k->swap_shifted = gst_rm_utils_swap_shifted_c;
+
+#if defined (RM_UTILS_HAVE_X86)
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2")) {
+    GST_DEBUG ("using SSE2 kernels");
+    k->swap_bytes = gst_rm_utils_swap_bytes_sse2;
+    k->swap_blocks = gst_rm_utils_swap_blocks_sse2;
+    k->swap_shifted = gst_rm_utils_swap_shifted_sse2;
+  }
+  /* sipr blocks are at most a few dozen bytes, too short for wider vectors
+   * to help */
+  if (__builtin_cpu_supports ("avx2")) {
+    GST_DEBUG ("using AVX2 byte swapping");
+    k->swap_bytes = gst_rm_utils_swap_bytes_avx2;
+  }
+#elif defined (RM_UTILS_HAVE_NEON)
+  GST_DEBUG ("using NEON kernels");
+  k->swap_bytes = gst_rm_utils_swap_bytes_neon;
+  k->swap_blocks = gst_rm_utils_swap_blocks_neon;
+  k->swap_shifted = gst_rm_utils_swap_shifted_neon;
+#endif
+
+  return k;
+}
+
+static const GstRMUtilsKernels *
+gst_rm_utils_get_kernels (void)
+{
+  static GstRMUtilsKernels kernels;
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, gst_rm_utils_init_kernels, &kernels);
+}
+
 GstBuffer *
 gst_rm_utils_descramble_dnet_buffer (GstBuffer * buf)
 {
   GstMapInfo map;
-  guint8 *data, *end, tmp;
 
   buf = gst_buffer_make_writable (buf);
 
   /* dnet = byte-order swapped AC3 */
   gst_buffer_map (buf, &map, GST_MAP_READWRITE);
-  data = map.data;
-  end = data + map.size;
-  while ((data + 1) < end) {
-    /* byte-swap */
-    tmp = data[0];
-    data[0] = data[1];
-    data[1] = tmp;
-    data += sizeof (guint16);
-  }
+  gst_rm_utils_get_kernels ()->swap_bytes (map.data, map.size);
   gst_buffer_unmap (buf, &map);
   return buf;
 }
 
+/* swaps the @len nibbles starting at nibble @idx1 with the ones starting at
+ * @idx2, odd indexes are the high nibble of a byte; the blocks must not
+ * overlap */
 static void
-gst_rm_utils_swap_nibbles (guint8 * data, gint idx1, gint idx2, gint len)
+gst_rm_utils_swap_nibbles (const GstRMUtilsKernels * k, guint8 * data,
+    gint idx1, gint idx2, gint len)
 {
-  guint8 *d1, *d2, tmp1 = 0, tmp2, tmp1n, tmp2n;
+  guint8 *d1, *d2, tmp1, tmp2;
+  gint n;
 
   if ((idx2 & 1) && !(idx1 & 1)) {
     /* align destination to a byte by swapping the indexes */
-    tmp1 = idx1;
+    n = idx1;
     idx1 = idx2;
-    idx2 = tmp1;
+    idx2 = n;
   }
   d1 = data + (idx1 >> 1);
   d2 = data + (idx2 >> 1);
@@ -169,40 +431,30 @@ gst_rm_utils_swap_nibbles (guint8 * data, gint idx1, gint idx2, gint len)
       *d2++ = (tmp1 & 0xf0) | (tmp2 & 0x0f);
       len--;
     }
-    for (; len > 1; len -= 2) {
-      /* swap 2 nibbles */
-      tmp1 = *d1;
-      *d1++ = *d2;
-      *d2++ = tmp1;
-    }
-    if (len) {
+    /* swap 2 nibbles at a time */
+    n = len / 2;
+    k->swap_blocks (d1, d2, n);
+    if (len & 1) {
       /* swap leftover nibble */
-      tmp1 = *d1;
-      tmp2 = *d2;
-      *d1 = (tmp2 & 0x0f) | (tmp1 & 0xf0);
-      *d2 = (tmp1 & 0x0f) | (tmp2 & 0xf0);
+      tmp1 = d1[n];
+      tmp2 = d2[n];
+      d1[n] = (tmp2 & 0x0f) | (tmp1 & 0xf0);
+      d2[n] = (tmp1 & 0x0f) | (tmp2 & 0xf0);
     }
   } else {
-    /* preload nibbles from source */
-    tmp2n = *d1;
-    tmp2 = *d2;
-
-    for (; len > 1; len -= 2) {
-      /* assemble nibbles */
-      *d1++ = (tmp2n & 0x0f) | (tmp2 << 4);
-      tmp1n = *d1;
-      *d2++ = (tmp1n << 4) | (tmp1 >> 4);
-
-      tmp1 = tmp1n;
-      tmp2n = (tmp2 >> 4);
-      tmp2 = *d2;
-    }
-    if (len) {
-      /* last leftover */
-      *d1 = (tmp2 << 4) | (tmp2n & 0x0f);
-      *d2 = (tmp1 >> 4) | (tmp2 & 0xf0);
+    /* idx1 is odd and idx2 even, so the nibbles move across bytes; the
+     * high nibble of the last byte of d2 the kernel overwrites goes to the
+     * low nibble of d1[n], which is done here */
+    n = len / 2;
+    tmp2 = n > 0 ? d2[n - 1] : (*d1 & 0x0f) << 4;
+    k->swap_shifted (d1, d2, n, (*d1 & 0x0f) << 4);
+    tmp1 = d1[n];
+    if (len & 1) {
+      /* swap leftover nibble */
+      d1[n] = (d2[n] << 4) | (tmp2 >> 4);
+      d2[n] = (d2[n] & 0xf0) | (tmp1 >> 4);
     } else {
-      *d1 = (tmp1 & 0xf0) | (tmp2n);
+      d1[n] = (tmp1 & 0xf0) | (tmp2 >> 4);
     }
   }
 }
@@ -223,6 +475,7 @@ static const gint sipr_swap_index[38][2] = {
 GstBuffer *
 gst_rm_utils_descramble_sipr_buffer (GstBuffer * buf)
 {
+  const GstRMUtilsKernels *k = gst_rm_utils_get_kernels ();
   GstMapInfo map;
   gint n, bs;
   gsize size;
@@ -247,48 +500,9 @@ gst_rm_utils_descramble_sipr_buffer (GstBuffer * buf)
     idx2 = bs * sipr_swap_index[n][1];
 
     /* swap the blocks */
-    gst_rm_utils_swap_nibbles (map.data, idx1, idx2, bs);
+    gst_rm_utils_swap_nibbles (k, map.data, idx1, idx2, bs);
   }
   gst_buffer_unmap (buf, &map);
 
   return buf;
 }
-
-void
-gst_rm_utils_run_tests (void)
-{
-#if 0
-  guint8 tab1[] = { 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe };
-  guint8 tab2[8];
-
-  memcpy (tab2, tab1, 8);
-  gst_util_dump_mem (tab2, 8);
-
-  gst_rm_utils_swap_nibbles (tab2, 0, 8, 4);
-  gst_util_dump_mem (tab2, 8);
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 0, 8, 5);
-  gst_util_dump_mem (tab2, 8);
-
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 1, 8, 4);
-  gst_util_dump_mem (tab2, 8);
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 1, 8, 5);
-  gst_util_dump_mem (tab2, 8);
-
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 0, 9, 4);
-  gst_util_dump_mem (tab2, 8);
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 0, 9, 5);
-  gst_util_dump_mem (tab2, 8);
-
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 1, 9, 4);
-  gst_util_dump_mem (tab2, 8);
-  memcpy (tab2, tab1, 8);
-  gst_rm_utils_swap_nibbles (tab2, 1, 9, 5);
-  gst_util_dump_mem (tab2, 8);
-#endif
-}
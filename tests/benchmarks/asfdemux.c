@@ -0,0 +1,198 @@
+/* GStreamer
+ *
+ * asfdemux.c: throughput of the asfdemux element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Demuxes the generated packets from the unit test, with every layout of
+ * the packet and payload headers, and prints packets per second and the
+ * number of buffers the demuxer had to allocate. The file has a single
+ * audio stream with small payloads, so this is run with and without
+ * buffer-list as well. Then demuxes audio streams
+ * with error correction and descrambles the same media objects with the
+ * straightforward reorder from the unit test, and prints the throughput of
+ * both. The number of packets and of media objects per stream can be given
+ * on the command line. */
+
+#include "../check/elements/asfdemux.h"
+
+#define DEFAULT_NUM_PACKETS 200000
+#define DEFAULT_NUM_OBJECTS 20000
+
+static gdouble
+throughput (guint num, guint size, gint64 elapsed)
+{
+  return (gdouble) num * size / MAX (elapsed, 1);
+}
+
+static guint
+get_stat (const GstStructure * stats, const gchar * field)
+{
+  guint val = 0;
+
+  if (!gst_structure_get_uint (stats, field, &val))
+    g_error ("no %s in the stats", field);
+
+  return val;
+}
+
+static void
+bench_packets (gboolean compressed, gboolean buffer_list, guint num)
+{
+  GstHarness *h;
+  GstBuffer **packets;
+  GstStructure *stats = NULL;
+  GstBuffer *buf;
+  PacketLayout l;
+  guint32 mo_number = 0;
+  guint i, num_bufs = 0, expected_bufs = 0;
+  gint64 start, elapsed;
+
+  /* create everything up front so only the demuxing gets measured */
+  packets = g_new (GstBuffer *, num);
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    layout_init (&l, i % layout_count (compressed), compressed);
+    packets[i] = create_packet (&l, &mo_number, &n_bufs, &n_bytes);
+    expected_bufs += n_bufs;
+  }
+
+  h = setup_asfdemux (num);
+  g_object_set (h->element, "buffer-list", buffer_list, NULL);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num; ++i) {
+    if (gst_harness_push (h, packets[i]) != GST_FLOW_OK)
+      g_error ("failed to push packet %u", i);
+    while ((buf = gst_harness_try_pull (h))) {
+      gst_buffer_unref (buf);
+      ++num_bufs;
+    }
+  }
+  gst_harness_push_event (h, gst_event_new_eos ());
+  while ((buf = gst_harness_try_pull (h))) {
+    gst_buffer_unref (buf);
+    ++num_bufs;
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  if (num_bufs != expected_bufs)
+    g_error ("got %u buffers instead of %u", num_bufs, expected_bufs);
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  if (stats == NULL)
+    g_error ("no stats");
+
+  g_print ("%s payloads%s: %u packets in %" G_GINT64_FORMAT " us, %.0f "
+      "packets/s, %u buffers, %u allocated, %u pooled, %u from downstream, "
+      "%u parse errors\n", compressed ? "compressed" : "plain",
+      buffer_list ? " as lists" : "", num, elapsed,
+      num * 1e6 / MAX (elapsed, 1), num_bufs,
+      get_stat (stats, "buffers-allocated"),
+      get_stat (stats, "buffers-pooled"),
+      get_stat (stats, "buffers-downstream"),
+      get_stat (stats, "parse-errors"));
+
+  gst_structure_free (stats);
+  gst_harness_teardown (h);
+  g_free (packets);
+}
+
+static void
+bench_descrambling (const StreamDesc * desc, guint num)
+{
+  GstHarness *h;
+  GstBuffer **packets;
+  guint8 *scrambled, *out;
+  guint mo_size, i, j, num_bufs = 0;
+  gint64 start, demux_time, ref_time;
+
+  mo_size = desc->span * desc->ds_packet_size;
+
+  /* create everything up front so only the demuxing gets measured */
+  scrambled = g_malloc ((gsize) num * mo_size);
+  out = g_malloc (mo_size);
+  packets = g_new (GstBuffer *, num);
+  for (i = 0; i < num; ++i) {
+    packets[i] = create_fragment_packet (desc->id, i, i * 10, mo_size, 0,
+        mo_size, TRUE);
+    for (j = 0; j < mo_size; ++j)
+      scrambled[(gsize) i * mo_size + j] = FRAGMENT_BYTE (i, j);
+  }
+
+  h = setup_asfdemux_with_header (create_header_full (desc, 1, num,
+          num * 10));
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num; ++i) {
+    GstBuffer *buf;
+
+    if (gst_harness_push (h, packets[i]) != GST_FLOW_OK)
+      g_error ("failed to push packet %u", i);
+    while ((buf = gst_harness_try_pull (h))) {
+      gst_buffer_unref (buf);
+      ++num_bufs;
+    }
+  }
+  demux_time = g_get_monotonic_time () - start;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num; ++i)
+    descramble_reference (desc, scrambled + (gsize) i * mo_size, out, mo_size);
+  ref_time = g_get_monotonic_time () - start;
+
+  if (num_bufs != num)
+    g_error ("got %u buffers instead of %u", num_bufs, num);
+
+  g_print ("span %u, packet size %u, chunk size %u: asfdemux %.1f MB/s (%"
+      G_GINT64_FORMAT " us), reference %.1f MB/s (%" G_GINT64_FORMAT " us)\n",
+      desc->span, desc->ds_packet_size, desc->ds_chunk_size,
+      throughput (num, mo_size, demux_time), demux_time,
+      throughput (num, mo_size, ref_time), ref_time);
+
+  gst_harness_teardown (h);
+  g_free (packets);
+  g_free (out);
+  g_free (scrambled);
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  guint i, num_packets = DEFAULT_NUM_PACKETS, num = DEFAULT_NUM_OBJECTS;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    num_packets = MAX ((guint) g_ascii_strtoull (argv[1], NULL, 10), 1);
+  if (argc > 2)
+    num = MAX ((guint) g_ascii_strtoull (argv[2], NULL, 10), 1);
+
+  g_print ("demuxing %u packets\n", num_packets);
+
+  bench_packets (FALSE, FALSE, num_packets);
+  bench_packets (FALSE, TRUE, num_packets);
+  bench_packets (TRUE, FALSE, num_packets);
+
+  g_print ("descrambling %u media objects per stream\n", num);
+
+  for (i = 0; i < G_N_ELEMENTS (descramble_streams); ++i)
+    bench_descrambling (&descramble_streams[i], num);
+
+  return 0;
+}
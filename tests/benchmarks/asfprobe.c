@@ -0,0 +1,218 @@
+/* GStreamer
+ *
+ * asfprobe.c: header probing throughput of the asf demuxer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Probes the headers of all files in a directory with
+ * gst_asf_demux_probe_header() from a thread pool, as an ingest service
+ * would, and prints how many files per second that gets through with
+ * different numbers of threads. Without a directory on the command line,
+ * generated files are written to a temporary directory first. */
+
+#include <stdio.h>
+#include <glib/gstdio.h>
+
+#include "../check/elements/asfdemux.h"
+#include "gstasfdemux.h"
+
+#define DEFAULT_NUM_FILES 1000
+#define PROBE_SIZE        (64 * 1024)
+
+typedef struct
+{
+  gint num_asf;
+  gint num_other;
+  gint num_packets;
+} ProbeResults;
+
+static gboolean
+read_start (FILE * f, guint8 * data, gsize size, gsize * p_read)
+{
+  if (fseek (f, 0, SEEK_SET) != 0)
+    return FALSE;
+
+  *p_read = fread (data, 1, size, f);
+  return TRUE;
+}
+
+static void
+probe_file (gpointer data, gpointer user_data)
+{
+  gchar *filename = data;
+  ProbeResults *results = user_data;
+  AsfHeaderInfo info;
+  guint8 *buf;
+  gsize size = PROBE_SIZE, len = 0;
+  gboolean ok = FALSE;
+  FILE *f;
+
+  buf = g_malloc (size);
+  f = g_fopen (filename, "rb");
+  if (f != NULL && read_start (f, buf, size, &len)) {
+    ok = gst_asf_demux_probe_header (buf, len, &info);
+
+    /* big headers, e.g. with lots of metadata or an embedded picture */
+    if (!ok && len == size && info.header_size > size &&
+        info.header_size <= G_MAXUINT32) {
+      size = info.header_size;
+      buf = g_realloc (buf, size);
+      if (read_start (f, buf, size, &len))
+        ok = gst_asf_demux_probe_header (buf, len, &info);
+    }
+  }
+
+  if (ok) {
+    g_atomic_int_inc (&results->num_asf);
+    g_atomic_int_add (&results->num_packets, (gint) info.num_packets);
+  } else {
+    g_atomic_int_inc (&results->num_other);
+  }
+
+  if (f != NULL)
+    fclose (f);
+  g_free (buf);
+}
+
+static void
+bench_threads (GPtrArray * files, guint num_threads)
+{
+  GThreadPool *pool;
+  ProbeResults results = { 0, };
+  gint64 start, elapsed;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  pool = g_thread_pool_new (probe_file, &results, num_threads, TRUE, NULL);
+  for (i = 0; i < files->len; ++i)
+    g_thread_pool_push (pool, g_ptr_array_index (files, i), NULL);
+  g_thread_pool_free (pool, FALSE, TRUE);
+  elapsed = g_get_monotonic_time () - start;
+
+  g_print ("%u threads: %u files in %" G_GINT64_FORMAT " us, %.0f files/s "
+      "(%d asf with %d packets, %d other)\n", num_threads, files->len,
+      elapsed, files->len * 1e6 / MAX (elapsed, 1), results.num_asf,
+      results.num_packets, results.num_other);
+}
+
+/* writes @num files with a header and a few data packets each */
+static gchar *
+create_files (guint num)
+{
+  PacketLayout l;
+  GError *err = NULL;
+  gchar *dir;
+  guint i, j;
+
+  dir = g_dir_make_tmp ("asfprobe-XXXXXX", &err);
+  if (dir == NULL)
+    g_error ("failed to create temporary directory: %s", err->message);
+
+  memset (&l, 0, sizeof (PacketLayout));
+  l.rep_data_type = 1;
+
+  for (i = 0; i < num; ++i) {
+    guint32 mo_number = 0;
+    gchar *filename;
+    GstBuffer *buf;
+    GstMapInfo map;
+    FILE *f;
+
+    filename = g_strdup_printf ("%s/%05u.asf", dir, i);
+    f = g_fopen (filename, "wb");
+    if (f == NULL)
+      g_error ("failed to create %s", filename);
+
+    buf = create_header (4, 40);
+    for (j = 0; j < 4; ++j) {
+      guint n_bufs, n_bytes;
+
+      buf = gst_buffer_append (buf, create_packet (&l, &mo_number, &n_bufs,
+              &n_bytes));
+    }
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    if (fwrite (map.data, 1, map.size, f) != map.size)
+      g_error ("failed to write %s", filename);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+
+    fclose (f);
+    g_free (filename);
+  }
+
+  return dir;
+}
+
+static void
+remove_files (const gchar * dir, GPtrArray * files)
+{
+  guint i;
+
+  for (i = 0; i < files->len; ++i)
+    g_unlink (g_ptr_array_index (files, i));
+  g_rmdir (dir);
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  GPtrArray *files;
+  GError *err = NULL;
+  const gchar *name;
+  gchar *dir;
+  gboolean generated = FALSE;
+  guint threads;
+  GDir *d;
+
+  gst_init (&argc, &argv);
+  GST_DEBUG_CATEGORY_INIT (asfdemux_dbg, "asfdemux", 0, "asf demuxer element");
+
+  if (argc > 1) {
+    dir = g_strdup (argv[1]);
+  } else {
+    dir = create_files (DEFAULT_NUM_FILES);
+    generated = TRUE;
+  }
+
+  d = g_dir_open (dir, 0, &err);
+  if (d == NULL)
+    g_error ("failed to open %s: %s", dir, err->message);
+
+  files = g_ptr_array_new_with_free_func (g_free);
+  while ((name = g_dir_read_name (d))) {
+    gchar *filename = g_build_filename (dir, name, NULL);
+
+    if (g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+      g_ptr_array_add (files, filename);
+    else
+      g_free (filename);
+  }
+  g_dir_close (d);
+
+  g_print ("probing %u files in %s\n", files->len, dir);
+
+  for (threads = 1; threads <= 2 * g_get_num_processors (); threads *= 2)
+    bench_threads (files, threads);
+
+  if (generated)
+    remove_files (dir, files);
+
+  g_ptr_array_unref (files);
+  g_free (dir);
+
+  return 0;
+}
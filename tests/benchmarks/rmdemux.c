@@ -0,0 +1,144 @@
+/* GStreamer
+ *
+ * rmdemux.c: descrambling throughput of the rmdemux element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Demuxes generated cook and sipr streams and descrambles the same blocks
+ * with the straightforward code from the unit test, and prints the
+ * throughput of both, best of a few runs. The number of blocks per stream
+ * and the number of runs can be given on the command line. */
+
+#include "../check/elements/rmdemux.h"
+
+#define DEFAULT_NUM_BLOCKS 2000
+#define DEFAULT_NUM_RUNS   7
+
+static gdouble
+throughput (const StreamLayout * l, guint num, gint64 elapsed)
+{
+  return (gdouble) num * l->height * l->packet_size / MAX (elapsed, 1);
+}
+
+static gint64
+time_rmdemux (const StreamLayout * l, GstBuffer ** blocks, guint num,
+    guint expected_bufs)
+{
+  GstHarness *h;
+  guint i, num_bufs = 0;
+  gint64 start, elapsed;
+
+  h = setup_rmdemux (l, num);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num; ++i) {
+    GstBuffer *buf;
+
+    /* the demuxer only reads the blocks, so they can be pushed again */
+    if (gst_harness_push (h, gst_buffer_ref (blocks[i])) != GST_FLOW_OK)
+      g_error ("failed to push block %u", i);
+    while ((buf = gst_harness_try_pull (h))) {
+      gst_buffer_unref (buf);
+      ++num_bufs;
+    }
+  }
+  elapsed = g_get_monotonic_time () - start;
+
+  if (num_bufs != expected_bufs)
+    g_error ("got %u buffers instead of %u", num_bufs, expected_bufs);
+
+  gst_harness_teardown (h);
+
+  return elapsed;
+}
+
+static gint64
+time_reference (const StreamLayout * l, const guint8 * payloads, guint num,
+    guint8 * out, guint * p_bufs)
+{
+  guint block_size = l->height * l->packet_size;
+  guint i;
+  gint64 start;
+
+  *p_bufs = 0;
+  start = g_get_monotonic_time ();
+  for (i = 0; i < num; ++i)
+    *p_bufs += descramble (l, payloads + (gsize) i * block_size, out);
+
+  return g_get_monotonic_time () - start;
+}
+
+static void
+bench_layout (const StreamLayout * l, guint num, guint runs)
+{
+  GstBuffer **blocks;
+  GRand *rand;
+  guint8 *payloads, *out;
+  guint block_size = l->height * l->packet_size;
+  guint i, expected_bufs = 0;
+  gint64 demux_time = G_MAXINT64, ref_time = G_MAXINT64;
+
+  /* create everything up front so only the descrambling gets measured */
+  payloads = g_malloc ((gsize) num * block_size);
+  out = g_malloc (block_size);
+  rand = g_rand_new_with_seed (0);
+  blocks = g_new (GstBuffer *, num);
+  for (i = 0; i < num; ++i)
+    blocks[i] = create_block (l, i, rand, payloads + (gsize) i * block_size);
+
+  for (i = 0; i < runs; ++i) {
+    ref_time = MIN (ref_time, time_reference (l, payloads, num, out,
+            &expected_bufs));
+    demux_time = MIN (demux_time, time_rmdemux (l, blocks, num,
+            expected_bufs));
+  }
+
+  g_print ("%s flavor %u, height %u, packet size %u, leaf size %u: "
+      "rmdemux %.1f MB/s (%" G_GINT64_FORMAT " us), reference %.1f MB/s (%"
+      G_GINT64_FORMAT " us)\n", l->fourcc, l->flavor, l->height,
+      l->packet_size, l->leaf_size, throughput (l, num, demux_time),
+      demux_time, throughput (l, num, ref_time), ref_time);
+
+  for (i = 0; i < num; ++i)
+    gst_buffer_unref (blocks[i]);
+  g_free (blocks);
+  g_rand_free (rand);
+  g_free (out);
+  g_free (payloads);
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  guint i, num = DEFAULT_NUM_BLOCKS, runs = DEFAULT_NUM_RUNS;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    num = MAX ((guint) g_ascii_strtoull (argv[1], NULL, 10), 1);
+  if (argc > 2)
+    runs = MAX ((guint) g_ascii_strtoull (argv[2], NULL, 10), 1);
+
+  g_print ("descrambling %u blocks per stream, best of %u runs\n", num, runs);
+
+  for (i = 0; i < G_N_ELEMENTS (layouts); ++i)
+    bench_layout (&layouts[i], num, runs);
+  for (i = 0; i < G_N_ELEMENTS (sipr_layouts); ++i)
+    bench_layout (&sipr_layouts[i], num, runs);
+
+  return 0;
+}
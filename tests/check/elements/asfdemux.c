@@ -0,0 +1,1252 @@
+/* GStreamer
+ *
+ * asfdemux.c: Unit test for the asfdemux element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The files used here are generated, see asfdemux.h. Besides going through
+ * the element, the demuxer code is linked in so the functions that don't need
+ * an element instance can be called directly. */
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbytereader.h>
+#include <glib/gstdio.h>
+
+#include "asfdemux.h"
+
+/* the demuxer header brings its own default debug category */
+#undef GST_CAT_DEFAULT
+#include "gstasfdemux.h"
+
+/* pulls everything the demuxer output so far, returns the number of buffers
+ * and adds up their size in @p_bytes */
+static guint
+drain_buffers (GstHarness * h, guint * p_bytes)
+{
+  GstBuffer *buf;
+  guint n = 0;
+
+  while ((buf = gst_harness_try_pull (h))) {
+    *p_bytes += gst_buffer_get_size (buf);
+    gst_buffer_unref (buf);
+    ++n;
+  }
+
+  return n;
+}
+
+static GstStructure *
+get_stats (GstHarness * h)
+{
+  GstStructure *stats = NULL;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+
+  return stats;
+}
+
+static guint
+get_stat (const GstStructure * stats, const gchar * field)
+{
+  guint val = 0;
+
+  fail_unless (gst_structure_get_uint (stats, field, &val));
+  return val;
+}
+
+
+static void
+check_all_layouts (gboolean compressed)
+{
+  GstHarness *h;
+  GstStructure *stats;
+  PacketLayout l;
+  guint32 mo_number = 0;
+  guint i, num, expected_buffers = 0, expected_bytes = 0;
+  guint buffers = 0, bytes = 0;
+
+  num = layout_count (compressed);
+  h = setup_asfdemux (num);
+
+  for (i = 0; i < num; ++i) {
+    GstBuffer *packet;
+    guint n_bufs, n_bytes;
+
+    layout_init (&l, i, compressed);
+    packet = create_packet (&l, &mo_number, &n_bufs, &n_bytes);
+    expected_buffers += n_bufs;
+    expected_bytes += n_bytes;
+
+    fail_unless_equals_int (gst_harness_push (h, packet), GST_FLOW_OK);
+    buffers += drain_buffers (h, &bytes);
+  }
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  buffers += drain_buffers (h, &bytes);
+
+  fail_unless_equals_int (buffers, expected_buffers);
+  fail_unless_equals_int (bytes, expected_bytes);
+
+  stats = get_stats (h);
+  fail_unless_equals_int (get_stat (stats, "packets-parsed"), num);
+  fail_unless_equals_int (get_stat (stats, "parse-errors"), 0);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_packet_layouts)
+{
+  check_all_layouts (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_compressed_payloads)
+{
+  check_all_layouts (TRUE);
+}
+
+GST_END_TEST;
+
+/* corrupts valid packets at random and makes sure the demuxer copes */
+GST_START_TEST (test_corrupt_packets)
+{
+  GstHarness *h;
+  GstStructure *stats;
+  PacketLayout l;
+  GRand *rand;
+  guint32 mo_number = 0;
+  guint i, num = 2000, bytes = 0;
+
+  rand = g_rand_new_with_seed (0x41534621);
+  h = setup_asfdemux (num);
+
+  for (i = 0; i < num; ++i) {
+    GstBuffer *packet;
+    GstMapInfo map;
+    guint n_bufs, n_bytes, j, n_corrupt;
+
+    layout_init (&l, g_rand_int_range (rand, 0, layout_count (FALSE)), FALSE);
+    packet = create_packet (&l, &mo_number, &n_bufs, &n_bytes);
+
+    gst_buffer_map (packet, &map, GST_MAP_WRITE);
+    n_corrupt = g_rand_int_range (rand, 1, 8);
+    for (j = 0; j < n_corrupt; ++j) {
+      /* mostly hit the headers, that's where the parsing happens */
+      guint pos = g_rand_int_range (rand, 0, g_rand_boolean (rand) ?
+          32 : PACKET_SIZE);
+      map.data[pos] = g_rand_int_range (rand, 0, 256);
+    }
+    gst_buffer_unmap (packet, &map);
+
+    gst_harness_push (h, packet);
+    drain_buffers (h, &bytes);
+  }
+
+  gst_harness_push_event (h, gst_event_new_eos ());
+  drain_buffers (h, &bytes);
+
+  stats = get_stats (h);
+  fail_unless_equals_int (get_stat (stats, "packets-parsed") +
+      get_stat (stats, "parse-errors"), num);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
+/* checks that unfragmented payloads never make the demuxer allocate
+ * memory */
+GST_START_TEST (test_unfragmented_no_allocations)
+{
+  GstHarness *h;
+  GstStructure *stats;
+  PacketLayout l;
+  guint32 mo_number = 0;
+  guint i, num = 2000, bytes = 0;
+
+  h = setup_asfdemux (num);
+
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    layout_init (&l, i % layout_count (FALSE), FALSE);
+    fail_unless_equals_int (gst_harness_push (h, create_packet (&l,
+                &mo_number, &n_bufs, &n_bytes)), GST_FLOW_OK);
+    drain_buffers (h, &bytes);
+  }
+
+  stats = get_stats (h);
+  fail_unless_equals_int (get_stat (stats, "parse-errors"), 0);
+  fail_unless_equals_int (get_stat (stats, "buffers-allocated"), 0);
+  fail_unless_equals_int (get_stat (stats, "buffers-pooled"), 0);
+  gst_structure_free (stats);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static gint upstream_time_seeks;
+static gint upstream_byte_seeks;
+static gint64 upstream_byte_seek_start;
+
+/* stands in for an http source, which can only seek in bytes */
+static gboolean
+upstream_event_func (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gboolean res = TRUE;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEEK) {
+    GstFormat format;
+    gint64 start;
+
+    gst_event_parse_seek (event, NULL, &format, NULL, NULL, &start, NULL,
+        NULL);
+    if (format == GST_FORMAT_BYTES) {
+      ++upstream_byte_seeks;
+      upstream_byte_seek_start = start;
+    } else {
+      ++upstream_time_seeks;
+      res = FALSE;
+    }
+  }
+  gst_event_unref (event);
+
+  return res;
+}
+
+/* the first 100 packets have one media object each, the others three, so
+ * estimating the position from the average bitrate would be way off */
+GST_START_TEST (test_push_seek_index)
+{
+  GstHarness *h;
+  GstBuffer *header;
+  PacketLayout l;
+  guint32 mo_number = 0, index[40];
+  guint i, num = 200, bytes = 0;
+  gsize data_offset;
+
+  header = create_header (num, 4000);
+  data_offset = gst_buffer_get_size (header);
+  gst_buffer_unref (header);
+
+  h = setup_asfdemux_with_duration (num, 4000);
+  gst_pad_set_event_function (h->srcpad, upstream_event_func);
+
+  memset (&l, 0, sizeof (PacketLayout));
+  l.rep_data_type = 1;
+  l.payload_length_type = 1;
+
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    l.num_payloads = (i < 100) ? 0 : 3;
+    gst_harness_push (h, create_packet (&l, &mo_number, &n_bufs, &n_bytes));
+    drain_buffers (h, &bytes);
+  }
+
+  /* media object m is at m * 10 ms */
+  for (i = 0; i < G_N_ELEMENTS (index); ++i) {
+    guint mo = i * 10;
+
+    index[i] = (mo < 100) ? mo : 100 + (mo - 100) / 3;
+  }
+  gst_harness_push (h, create_simple_index (index, G_N_ELEMENTS (index), 100));
+
+  fail_unless (gst_harness_push_upstream_event (h,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+              GST_SEEK_TYPE_SET, 3 * GST_SECOND, GST_SEEK_TYPE_NONE, -1)));
+
+  /* upstream gets to try the time seek, then there's exactly one byte seek
+   * straight to the packet from the index */
+  fail_unless_equals_int (upstream_time_seeks, 1);
+  fail_unless_equals_int (upstream_byte_seeks, 1);
+  fail_unless_equals_int64 (upstream_byte_seek_start,
+      data_offset + (gint64) index[30] * PACKET_SIZE);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* two video streams with a media object every 20 ms each and keyframes at
+ * different times; media object n of the stream at index s is in packet
+ * 2 * n + s */
+static const StreamDesc two_video_streams[] = {
+  {1, TRUE, 0, 0, 0},
+  {2, TRUE, 0, 0, 0},
+};
+
+static gboolean
+two_video_is_keyframe (guint s, guint n)
+{
+  return n == 0 || n % 10 == (s == 0 ? 0 : 5);
+}
+
+/* packet of the last keyframe of stream @s at or before media object @n */
+static guint32
+two_video_keyframe_packet (guint s, guint n)
+{
+  while (!two_video_is_keyframe (s, n))
+    --n;
+
+  return 2 * n + s;
+}
+
+/* seeks to @seek_ms and checks that the demuxer asks upstream for the packet
+ * of the earlier of the two keyframes, so both streams start with theirs */
+static void
+check_push_seek_two_streams (GstHarness * h, gsize data_offset, guint seek_ms,
+    guint32 expected_packet)
+{
+  upstream_time_seeks = upstream_byte_seeks = 0;
+
+  fail_unless (gst_harness_push_upstream_event (h,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME,
+              GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
+              GST_SEEK_TYPE_SET, seek_ms * GST_MSECOND, GST_SEEK_TYPE_NONE,
+              -1)));
+
+  fail_unless_equals_int (upstream_time_seeks, 1);
+  fail_unless_equals_int (upstream_byte_seeks, 1);
+  fail_unless_equals_int64 (upstream_byte_seek_start,
+      data_offset + (gint64) expected_packet * PACKET_SIZE);
+}
+
+/* an index object with cleanpoints for each of two video streams */
+GST_START_TEST (test_push_seek_stream_index)
+{
+  GstHarness *h;
+  GstBuffer *header;
+  guint32 index[20 * 2];
+  guint i, num = 100, bytes = 0;
+  gsize data_offset;
+
+  header = create_header_full (two_video_streams, 2, 2 * num, num * 20);
+  data_offset = gst_buffer_get_size (header);
+
+  h = setup_asfdemux_with_header (header);
+  gst_pad_set_event_function (h->srcpad, upstream_event_func);
+
+  for (i = 0; i < 2 * num; ++i) {
+    guint s = i % 2, n = i / 2;
+
+    fail_unless_equals_int (gst_harness_push (h,
+            create_fragment_packet (two_video_streams[s].id, n, n * 20, 100,
+                0, 100, two_video_is_keyframe (s, n))), GST_FLOW_OK);
+    drain_buffers (h, &bytes);
+  }
+
+  /* one entry every 100 ms, that is every 5th media object */
+  for (i = 0; i < G_N_ELEMENTS (index); ++i)
+    index[i] = two_video_keyframe_packet (i % 2, (i / 2) * 5);
+  fail_unless_equals_int (gst_harness_push (h, create_index (two_video_streams,
+              2, 3, index, G_N_ELEMENTS (index) / 2, 100)), GST_FLOW_OK);
+
+  /* the keyframe of the second stream comes first */
+  fail_unless (two_video_keyframe_packet (1, 60) <
+      two_video_keyframe_packet (0, 60));
+  check_push_seek_two_streams (h, data_offset, 1200,
+      two_video_keyframe_packet (1, 60));
+
+  /* and here the one of the first stream */
+  fail_unless (two_video_keyframe_packet (0, 75) <
+      two_video_keyframe_packet (1, 75));
+  check_push_seek_two_streams (h, data_offset, 1500,
+      two_video_keyframe_packet (0, 75));
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* plays the first @num_push of @num packets with the index cache in @dir and
+ * returns the packet a seek to @seek_ms starts at */
+static guint
+seek_with_index_cache (const gchar * dir, guint num, guint num_push,
+    guint seek_ms)
+{
+  GstHarness *h;
+  GstBuffer *header;
+  gsize data_offset;
+  guint i, bytes = 0;
+
+  header = create_header (num, num * 10);
+  data_offset = gst_buffer_get_size (header);
+
+  h = setup_asfdemux_without_header ();
+  g_object_set (h->element, "index-cache-dir", dir, NULL);
+  fail_unless_equals_int (gst_harness_push (h, header), GST_FLOW_OK);
+  gst_pad_set_event_function (h->srcpad, upstream_event_func);
+
+  for (i = 0; i < num_push; ++i) {
+    fail_unless_equals_int (gst_harness_push (h,
+            create_fragment_packet (STREAM_ID, i, i * 10, 100, 0, 100,
+                TRUE)), GST_FLOW_OK);
+    drain_buffers (h, &bytes);
+  }
+
+  upstream_byte_seeks = 0;
+  fail_unless (gst_harness_push_upstream_event (h,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+              GST_SEEK_TYPE_SET, seek_ms * GST_MSECOND, GST_SEEK_TYPE_NONE,
+              -1)));
+  fail_unless_equals_int (upstream_byte_seeks, 1);
+
+  /* stores the index in the cache */
+  gst_harness_teardown (h);
+
+  return (upstream_byte_seek_start - data_offset) / PACKET_SIZE;
+}
+
+/* the index learned while playing a file is stored in the cache directory,
+ * and used for seeking when the same file is played again; a cache file
+ * that doesn't check out is ignored */
+GST_START_TEST (test_index_cache)
+{
+  GstByteReader reader;
+  GError *err = NULL;
+  const gchar *name;
+  const guint8 *magic;
+  gchar *dir, *filename, *contents;
+  guint32 val32, count;
+  guint64 val64;
+  guint16 val16;
+  gsize len;
+  GDir *d;
+  guint i, num = 500;
+
+  dir = g_dir_make_tmp ("asfdemux-XXXXXX", &err);
+  fail_unless (dir != NULL);
+
+  /* one media object every 10 ms, learned about once a second while
+   * playing */
+  fail_unless_equals_int (seek_with_index_cache (dir, num, num, 2500), 200);
+
+  d = g_dir_open (dir, 0, NULL);
+  fail_unless (d != NULL);
+  name = g_dir_read_name (d);
+  fail_unless (name != NULL);
+  filename = g_build_filename (dir, name, NULL);
+  fail_unless (g_dir_read_name (d) == NULL);
+  g_dir_close (d);
+
+  fail_unless (g_file_get_contents (filename, &contents, &len, NULL));
+  gst_byte_reader_init (&reader, (const guint8 *) contents, len);
+  fail_unless (gst_byte_reader_get_data (&reader, 8, &magic));
+  fail_unless (memcmp (magic, "GstAsfIx", 8) == 0);
+  fail_unless (gst_byte_reader_get_uint32_le (&reader, &val32));
+  fail_unless_equals_int (val32, 1);
+  fail_unless (gst_byte_reader_get_uint32_le (&reader, &val32));
+  fail_unless_equals_int (val32, PACKET_SIZE);
+  fail_unless (gst_byte_reader_get_uint64_le (&reader, &val64));
+  fail_unless_equals_uint64 (val64, num);
+  fail_unless (gst_byte_reader_get_uint16_le (&reader, &val16));
+  fail_unless_equals_int (val16, STREAM_ID);
+  fail_unless (gst_byte_reader_skip (&reader, 2));
+  fail_unless (gst_byte_reader_get_uint32_le (&reader, &count));
+  fail_unless_equals_int (count, 5);
+  fail_unless_equals_int (gst_byte_reader_get_remaining (&reader), count * 16);
+  for (i = 0; i < count; ++i) {
+    fail_unless (gst_byte_reader_get_uint64_le (&reader, &val64));
+    fail_unless_equals_uint64 (val64, i * GST_SECOND);
+    fail_unless (gst_byte_reader_get_uint32_le (&reader, &val32));
+    fail_unless_equals_int (val32, i * 100);
+    /* played from one entry to the next */
+    fail_unless (gst_byte_reader_get_uint32_le (&reader, &val32));
+    fail_unless_equals_int (val32, i > 0 ? 1 : 0);
+  }
+
+  /* the next time, the index is there before getting to the seek position */
+  fail_unless_equals_int (seek_with_index_cache (dir, num, 10, 2500), 200);
+
+  /* a truncated cache file is ignored, so the position is estimated */
+  fail_unless (g_file_set_contents (filename, contents, len - 4, NULL));
+  fail_unless_equals_int (seek_with_index_cache (dir, num, 10, 2500), 250);
+
+  g_unlink (filename);
+  g_rmdir (dir);
+  g_free (contents);
+  g_free (filename);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstBuffer *file;
+  guint64 offset;
+  GMutex lock;
+  guint num_reads;
+  GQueue buffers;
+} RandomAccessSource;
+
+static gboolean
+seek_data_cb (GstElement * appsrc, guint64 offset, RandomAccessSource * src)
+{
+  g_mutex_lock (&src->lock);
+  src->offset = offset;
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+/* appsrc in random-access mode asks for data once for every pull_range */
+static void
+need_data_cb (GstElement * appsrc, guint length, RandomAccessSource * src)
+{
+  gsize size = gst_buffer_get_size (src->file);
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&src->lock);
+  if (src->offset < size) {
+    length = MIN (length, size - src->offset);
+    buf = gst_buffer_copy_region (src->file, GST_BUFFER_COPY_ALL, src->offset,
+        length);
+    src->offset += length;
+  }
+  ++src->num_reads;
+  g_mutex_unlock (&src->lock);
+
+  if (buf != NULL) {
+    g_signal_emit_by_name (appsrc, "push-buffer", buf, &ret);
+    gst_buffer_unref (buf);
+  } else {
+    g_signal_emit_by_name (appsrc, "end-of-stream", &ret);
+  }
+}
+
+static void
+clear_buffers (RandomAccessSource * src)
+{
+  GstBuffer *buf;
+
+  while ((buf = g_queue_pop_head (&src->buffers)))
+    gst_buffer_unref (buf);
+}
+
+/* keeps the buffers pushed since the last flush */
+static GstPadProbeReturn
+record_buffers_probe (GstPad * pad, GstPadProbeInfo * info,
+    RandomAccessSource * src)
+{
+  g_mutex_lock (&src->lock);
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER)
+    g_queue_push_tail (&src->buffers,
+        gst_buffer_ref (GST_PAD_PROBE_INFO_BUFFER (info)));
+  else if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+      GST_EVENT_FLUSH_STOP)
+    clear_buffers (src);
+  g_mutex_unlock (&src->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+link_fakesink_cb (GstElement * demux, GstPad * pad, RandomAccessSource * src)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  gst_bin_add (GST_BIN (GST_ELEMENT_PARENT (demux)), sink);
+  gst_element_sync_state_with_parent (sink);
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      (GstPadProbeCallback) record_buffers_probe, src, NULL);
+}
+
+/* appsrc with the file from @src in random-access mode, the demuxer and a
+ * fakesink for each of its pads */
+static GstElement *
+create_pull_pipeline (RandomAccessSource * src, guint read_ahead)
+{
+  GstElement *pipeline, *appsrc, *demux;
+  GstCaps *caps;
+
+  pipeline = gst_pipeline_new (NULL);
+  appsrc = gst_element_factory_make ("appsrc", NULL);
+  demux = gst_element_factory_make ("asfdemux", NULL);
+  fail_unless (appsrc != NULL && demux != NULL);
+  gst_util_set_object_arg (G_OBJECT (appsrc), "stream-type", "random-access");
+  caps = gst_caps_new_empty_simple ("video/x-ms-asf");
+  g_object_set (appsrc, "size", (gint64) gst_buffer_get_size (src->file),
+      "caps", caps, NULL);
+  gst_caps_unref (caps);
+  g_object_set (demux, "read-ahead", read_ahead, NULL);
+  g_signal_connect (appsrc, "seek-data", G_CALLBACK (seek_data_cb), src);
+  g_signal_connect (appsrc, "need-data", G_CALLBACK (need_data_cb), src);
+  g_signal_connect (demux, "pad-added", G_CALLBACK (link_fakesink_cb), src);
+  gst_bin_add_many (GST_BIN (pipeline), appsrc, demux, NULL);
+  fail_unless (gst_element_link (appsrc, demux));
+
+  return pipeline;
+}
+
+static void
+play_until_eos (GstElement * pipeline)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+}
+
+/* plays @file in pull mode with @read_ahead and returns the number of reads
+ * from upstream */
+static guint
+play_pull_mode (GstBuffer * file, guint read_ahead, guint expected_buffers,
+    guint expected_bytes)
+{
+  RandomAccessSource src = { NULL, };
+  GstElement *pipeline;
+  GList *l;
+  guint bytes = 0;
+
+  src.file = file;
+  g_mutex_init (&src.lock);
+
+  pipeline = create_pull_pipeline (&src, read_ahead);
+  play_until_eos (pipeline);
+  gst_object_unref (pipeline);
+
+  for (l = src.buffers.head; l != NULL; l = l->next)
+    bytes += gst_buffer_get_size (l->data);
+  fail_unless_equals_int (src.buffers.length, expected_buffers);
+  fail_unless_equals_int (bytes, expected_bytes);
+  clear_buffers (&src);
+  g_mutex_clear (&src.lock);
+
+  return src.num_reads;
+}
+
+/* reading ahead in pull mode gives the same output with fewer reads; the
+ * packets don't line up with the aligned windows, so some of them straddle
+ * two windows, and the last window is cut short by the end of the file */
+GST_START_TEST (test_pull_read_ahead)
+{
+  GstBuffer *file;
+  PacketLayout l;
+  guint32 mo_number = 0;
+  guint i, num = 40, expected_buffers = 0, expected_bytes = 0, reads;
+  guint read_ahead = 4096;
+  gsize size;
+
+  memset (&l, 0, sizeof (PacketLayout));
+  l.rep_data_type = 1;
+
+  file = create_header (num, num * 10);
+  fail_unless (gst_buffer_get_size (file) % PACKET_SIZE != 0);
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    file = gst_buffer_append (file, create_packet (&l, &mo_number, &n_bufs,
+            &n_bytes));
+    expected_buffers += n_bufs;
+    expected_bytes += n_bytes;
+  }
+  size = gst_buffer_get_size (file);
+  fail_unless (size % read_ahead != 0);
+
+  /* the start of the header object, the header and the start of the data
+   * object, then every packet on its own; the index isn't there */
+  reads = play_pull_mode (file, 0, expected_buffers, expected_bytes);
+  fail_unless_equals_int (reads, 3 + num);
+
+  /* each refill starts at the first packet the last window didn't have all
+   * of, so it covers at least read_ahead - PACKET_SIZE new bytes */
+  reads = play_pull_mode (file, read_ahead, expected_buffers, expected_bytes);
+  fail_unless (reads >= (size + read_ahead - 1) / read_ahead);
+  fail_unless (reads <= 1 + (size + read_ahead - PACKET_SIZE - 1) /
+      (read_ahead - PACKET_SIZE));
+
+  /* everything in one window */
+  reads = play_pull_mode (file, 64 * 1024, expected_buffers, expected_bytes);
+  fail_unless_equals_int (reads, 1);
+
+  gst_buffer_unref (file);
+}
+
+GST_END_TEST;
+
+/* in reverse playback the packets are read backwards, so the fragments of
+ * each media object come in from the last one to the first one, and have to
+ * be put together in the payload queued for it */
+GST_START_TEST (test_reverse_fragments)
+{
+  static const StreamDesc video = { STREAM_ID, TRUE, 0, 0, 0 };
+  RandomAccessSource src = { NULL, };
+  GstElement *pipeline;
+  guint num = 30, last = 20, frag_len = 60, mo_size = 3 * frag_len, n, i;
+
+  /* three fragments for each media object, one every 10 ms */
+  src.file = create_header_full (&video, 1, 3 * num, num * 10);
+  for (n = 0; n < num; ++n) {
+    for (i = 0; i < 3; ++i)
+      src.file = gst_buffer_append (src.file,
+          create_fragment_packet (STREAM_ID, n, n * 10, mo_size,
+              i * frag_len, frag_len, TRUE));
+  }
+  g_mutex_init (&src.lock);
+
+  pipeline = create_pull_pipeline (&src, 0);
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (gst_element_seek (pipeline, -1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_SET,
+          last * 10 * GST_MSECOND));
+  play_until_eos (pipeline);
+  gst_object_unref (pipeline);
+
+  /* the media objects up to the segment stop, last to first */
+  fail_unless_equals_int (src.buffers.length, last + 1);
+  for (n = last + 1; n-- > 0;) {
+    GstBuffer *buf = g_queue_pop_head (&src.buffers);
+    GstMapInfo map;
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), n * 10 * GST_MSECOND);
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    fail_unless_equals_int (map.size, mo_size);
+    for (i = 0; i < mo_size; ++i)
+      fail_unless_equals_int (map.data[i], FRAGMENT_BYTE (n, i));
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  gst_buffer_unref (src.file);
+  g_mutex_clear (&src.lock);
+}
+
+GST_END_TEST;
+
+static void
+count_pads_cb (GstElement * demux, GstPad * pad, guint * p_count)
+{
+  ++*p_count;
+}
+
+/* a new header for the same streams, as live servers send them, must not
+ * make the demuxer replace its pads */
+GST_START_TEST (test_chained_header_keeps_pads)
+{
+  GstHarness *h;
+  PacketLayout l;
+  guint32 mo_number = 0;
+  guint i, num = 50, pads_added = 0, buffers = 0, bytes = 0;
+
+  h = setup_asfdemux (num);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (count_pads_cb),
+      &pads_added);
+
+  memset (&l, 0, sizeof (PacketLayout));
+  l.rep_data_type = 1;
+
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    gst_harness_push (h, create_packet (&l, &mo_number, &n_bufs, &n_bytes));
+    drain_buffers (h, &bytes);
+  }
+  fail_unless_equals_int (pads_added, 1);
+
+  fail_unless_equals_int (gst_harness_push (h, create_header (num, num * 10)),
+      GST_FLOW_OK);
+  mo_number = 0;
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    gst_harness_push (h, create_packet (&l, &mo_number, &n_bufs, &n_bytes));
+    buffers += drain_buffers (h, &bytes);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  buffers += drain_buffers (h, &bytes);
+
+  fail_unless_equals_int (pads_added, 1);
+  fail_unless_equals_int (h->element->numsrcpads, 1);
+  fail_unless_equals_int (buffers, num);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* two variants of the same audio at different bitrates; only the one that
+ * fits max-bitrate gets a pad, and the payloads of the other are skipped */
+static void
+check_mbr_pruning (guint max_bitrate, guint expected_id)
+{
+  static const StreamDesc streams[] = {
+    {1, FALSE, 0, 0, 0},
+    {2, FALSE, 0, 0, 0},
+  };
+  static const guint32 bitrates[] = { 64000, 128000 };
+  GstHarness *h;
+  GstBuffer *buf;
+  guint i, num = 20, pads_added = 0, buffers = 0;
+
+  h = setup_asfdemux_without_header ();
+  g_object_set (h->element, "max-bitrate", max_bitrate, NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (count_pads_cb),
+      &pads_added);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_header_with_bitrates (streams, 2, bitrates, 2 * num,
+              num * 10)), GST_FLOW_OK);
+
+  /* the variants are told apart by the size of their media objects */
+  for (i = 0; i < 2 * num; ++i) {
+    guint id = streams[i % 2].id, mo_size = 100 * id;
+
+    fail_unless_equals_int (gst_harness_push (h,
+            create_fragment_packet (id, i / 2, (i / 2) * 10, mo_size, 0,
+                mo_size, TRUE)), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buf = gst_harness_try_pull (h))) {
+    fail_unless_equals_int (gst_buffer_get_size (buf), 100 * expected_id);
+    gst_buffer_unref (buf);
+    ++buffers;
+  }
+
+  fail_unless_equals_int (pads_added, 1);
+  fail_unless_equals_int (h->element->numsrcpads, 1);
+  fail_unless_equals_int (buffers, num);
+
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_mbr_pruning)
+{
+  check_mbr_pruning (100000, 1);
+  check_mbr_pruning (200000, 2);
+  /* nothing fits, so the lowest bitrate */
+  check_mbr_pruning (32000, 1);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstPad *pad;
+  GstClockTime pts;
+} PushedBuffer;
+
+static GArray *pushed_order;
+
+/* the harness only gets the first pad, but the probes see the buffers of
+ * the others as well */
+static GstPadProbeReturn
+record_order_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  PushedBuffer b;
+
+  b.pad = pad;
+  b.pts = GST_BUFFER_PTS (GST_PAD_PROBE_INFO_BUFFER (info));
+  g_array_append_val (pushed_order, b);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+record_order_cb (GstElement * demux, GstPad * pad, gpointer user_data)
+{
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, record_order_probe, NULL,
+      NULL);
+}
+
+static void
+push_interleave_object (GstHarness * h, const StreamDesc * streams, guint s,
+    guint n)
+{
+  /* the streams are 10 ms apart, with a media object every 30 ms each */
+  fail_unless_equals_int (gst_harness_push (h,
+          create_fragment_packet (streams[s].id, n, n * 30 + s * 10, 100, 0,
+              100, TRUE)), GST_FLOW_OK);
+}
+
+/* whatever order the payloads of several streams come in, the queued ones
+ * go out by timestamp: the packets up to the preroll come in one stream
+ * after the other, backwards, the rest in timestamp order */
+GST_START_TEST (test_interleave_streams)
+{
+  static const StreamDesc streams[] = {
+    {1, TRUE, 0, 0, 0},
+    {2, FALSE, 0, 0, 0},
+    {3, FALSE, 0, 0, 0},
+  };
+  GstHarness *h;
+  GstPad *pads[3] = { NULL, };
+  guint counts[3] = { 0, };
+  guint num = 40, preroll_num = 18, bytes = 0, i, n, s;
+
+  pushed_order = g_array_new (FALSE, FALSE, sizeof (PushedBuffer));
+
+  h = setup_asfdemux_with_header (create_header_full (streams, 3, 3 * num,
+          num * 30));
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (record_order_cb),
+      NULL);
+
+  /* the demuxer starts once all streams have data beyond 500 ms, which is
+   * with the last media object of the video stream that comes last */
+  fail_unless ((preroll_num - 1) * 30 > 500);
+  fail_unless ((preroll_num - 2) * 30 <= 500);
+  for (s = 3; s-- > 0;) {
+    for (n = 0; n < preroll_num; ++n)
+      push_interleave_object (h, streams, s, n);
+  }
+  for (n = preroll_num; n < num; ++n) {
+    for (s = 0; s < 3; ++s)
+      push_interleave_object (h, streams, s, n);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  drain_buffers (h, &bytes);
+
+  fail_unless_equals_int (pushed_order->len, 3 * num);
+  for (i = 0; i < pushed_order->len; ++i) {
+    PushedBuffer *b = &g_array_index (pushed_order, PushedBuffer, i);
+
+    /* one stream after the other every 10 ms */
+    fail_unless_equals_uint64 (b->pts, i * 10 * GST_MSECOND);
+    s = i % 3;
+    if (pads[s] == NULL)
+      pads[s] = b->pad;
+    fail_unless (b->pad == pads[s]);
+    ++counts[s];
+  }
+  fail_unless (pads[0] != pads[1] && pads[1] != pads[2] &&
+      pads[0] != pads[2]);
+  for (s = 0; s < 3; ++s)
+    fail_unless_equals_int (counts[s], num);
+
+  gst_harness_teardown (h);
+  g_array_unref (pushed_order);
+  pushed_order = NULL;
+}
+
+GST_END_TEST;
+
+static guint
+count_allocations (GstHarness * h)
+{
+  GstStructure *stats;
+  guint n;
+
+  stats = get_stats (h);
+  n = get_stat (stats, "buffers-allocated") +
+      get_stat (stats, "buffers-pooled") +
+      get_stat (stats, "buffers-downstream");
+  gst_structure_free (stats);
+
+  return n;
+}
+
+/* pushes media object @mo_number in fragments of @frag_len bytes and checks
+ * what the demuxer makes of it */
+static void
+check_fragmented_object (GstHarness * h, guint32 mo_number, guint mo_size,
+    guint frag_len, guint expected_memories, guint expected_allocations)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint allocations, offset, i;
+
+  allocations = count_allocations (h);
+
+  for (offset = 0; offset < mo_size; offset += frag_len) {
+    fail_unless (gst_harness_try_pull (h) == NULL);
+    fail_unless_equals_int (gst_harness_push (h,
+            create_fragment_packet (STREAM_ID, mo_number, mo_number * 10,
+                mo_size, offset, MIN (frag_len, mo_size - offset), TRUE)),
+        GST_FLOW_OK);
+  }
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), mo_size);
+  fail_unless_equals_int (gst_buffer_n_memory (buf), expected_memories);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+      mo_number * 10 * GST_MSECOND);
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  for (i = 0; i < mo_size; ++i)
+    fail_unless_equals_int (map.data[i], FRAGMENT_BYTE (mo_number, i));
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  fail_unless_equals_int (count_allocations (h) - allocations,
+      expected_allocations);
+}
+
+GST_START_TEST (test_many_fragments)
+{
+  GstHarness *h;
+  guint max_memory = gst_buffer_get_max_memory ();
+
+  h = setup_asfdemux (8 + max_memory + (max_memory + 4) + (max_memory + 1));
+
+  /* a few fragments are kept as memory shares of the packets */
+  check_fragmented_object (h, 0, 8 * 100, 100, 8, 0);
+  check_fragmented_object (h, 1, max_memory * 100, 100, max_memory, 0);
+  /* more than a buffer can hold, assembled in a single allocation */
+  check_fragmented_object (h, 2, (max_memory + 4) * 100, 100, 1, 1);
+  /* the last fragment is a small one */
+  check_fragmented_object (h, 3, max_memory * 100 + 1, 100, 1, 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+check_descrambling (const StreamDesc * desc)
+{
+  GstHarness *h;
+  guint8 *scrambled, *expected;
+  guint mo_size, num = 3, mo_number, i;
+
+  mo_size = desc->span * desc->ds_packet_size;
+  fail_unless (mo_size <= FRAGMENT_MAX_LEN);
+  scrambled = g_malloc (mo_size);
+  expected = g_malloc (mo_size);
+
+  h = setup_asfdemux_with_header (create_header_full (desc, 1, num,
+          num * 10));
+
+  for (mo_number = 0; mo_number < num; ++mo_number) {
+    GstBuffer *buf;
+
+    fail_unless_equals_int (gst_harness_push (h,
+            create_fragment_packet (desc->id, mo_number, mo_number * 10,
+                mo_size, 0, mo_size, TRUE)), GST_FLOW_OK);
+
+    for (i = 0; i < mo_size; ++i)
+      scrambled[i] = FRAGMENT_BYTE (mo_number, i);
+    descramble_reference (desc, scrambled, expected, mo_size);
+
+    buf = gst_harness_pull (h);
+    fail_unless_equals_int (gst_buffer_get_size (buf), mo_size);
+    fail_unless (gst_buffer_memcmp (buf, 0, expected, mo_size) == 0);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+  g_free (expected);
+  g_free (scrambled);
+}
+
+GST_START_TEST (test_descrambling)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (descramble_streams); ++i)
+    check_descrambling (&descramble_streams[i]);
+}
+
+GST_END_TEST;
+
+static GQueue pushed_lists = G_QUEUE_INIT;
+static guint pushed_buffers;
+
+static GstPadProbeReturn
+record_lists_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST)
+    g_queue_push_tail (&pushed_lists,
+        gst_buffer_list_ref (GST_PAD_PROBE_INFO_BUFFER_LIST (info)));
+  else
+    ++pushed_buffers;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+record_lists_cb (GstElement * demux, GstPad * pad, gpointer user_data)
+{
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      record_lists_probe, NULL, NULL);
+}
+
+/* packets with several payloads each must come out as lists, with the
+ * buffers in order and only the very first one marked DISCONT */
+GST_START_TEST (test_buffer_list)
+{
+  GstHarness *h;
+  GstBufferList *list;
+  PacketLayout l;
+  guint32 mo_number = 0;
+  guint i, j, num = 20, idx = 0, bytes = 0, max_len = 0;
+
+  memset (&l, 0, sizeof (PacketLayout));
+  l.rep_data_type = 1;
+  l.padding_type = 2;
+  l.num_payloads = 3;
+  l.payload_length_type = 2;
+
+  h = setup_asfdemux (num);
+  g_object_set (h->element, "buffer-list", TRUE, NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (record_lists_cb),
+      NULL);
+
+  for (i = 0; i < num; ++i) {
+    guint n_bufs, n_bytes;
+
+    fail_unless_equals_int (gst_harness_push (h, create_packet (&l,
+                &mo_number, &n_bufs, &n_bytes)), GST_FLOW_OK);
+    fail_unless_equals_int (n_bufs, 3);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (drain_buffers (h, &bytes), num * 3);
+  fail_unless_equals_int (pushed_buffers, 0);
+
+  while ((list = g_queue_pop_head (&pushed_lists))) {
+    max_len = MAX (max_len, gst_buffer_list_length (list));
+
+    for (j = 0; j < gst_buffer_list_length (list); ++j, ++idx) {
+      GstBuffer *buf = gst_buffer_list_get (list, j);
+
+      fail_unless_equals_int (gst_buffer_get_size (buf), 32 + 4 * (idx % 3));
+      fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), idx * 10 * GST_MSECOND);
+      fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (buf,
+              GST_BUFFER_FLAG_DISCONT), idx == 0);
+    }
+    gst_buffer_list_unref (list);
+  }
+  fail_unless_equals_int (idx, num * 3);
+  fail_unless (max_len > 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static gboolean
+probe_buffer (GstBuffer * buf, gsize size, AsfHeaderInfo * info)
+{
+  GstMapInfo map;
+  gboolean ret;
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless (size <= map.size);
+  ret = gst_asf_demux_probe_header (map.data, size, info);
+  gst_buffer_unmap (buf, &map);
+
+  return ret;
+}
+
+GST_START_TEST (test_probe_header)
+{
+  AsfHeaderInfo info;
+  GstBuffer *header;
+  GstMapInfo map;
+  gsize header_size;
+
+  header = create_header (100, 1000);
+  /* the buffer ends with the start of the data object */
+  header_size = gst_buffer_get_size (header) - 50;
+
+  fail_unless (probe_buffer (header, gst_buffer_get_size (header), &info));
+  fail_unless_equals_uint64 (info.header_size, header_size);
+  fail_unless_equals_int (info.file_guid.v1, guid_data[0]);
+  fail_unless_equals_uint64 (info.num_packets, 100);
+  fail_unless_equals_int (info.packet_size, PACKET_SIZE);
+  fail_unless_equals_int (info.max_bitrate, 128000);
+  fail_unless_equals_uint64 (info.duration, GST_SECOND);
+  fail_unless_equals_uint64 (info.preroll, 0);
+  fail_unless (!info.broadcast);
+  fail_unless (info.seekable);
+  fail_unless (!info.encrypted);
+  fail_unless_equals_int (info.num_audio_streams, 1);
+  fail_unless_equals_int (info.num_video_streams, 0);
+  fail_unless_equals_int (info.num_other_streams, 0);
+
+  /* not the whole header object, but it says how much is needed */
+  fail_unless (!probe_buffer (header, header_size - 1, &info));
+  fail_unless_equals_uint64 (info.header_size, header_size);
+  fail_unless (!probe_buffer (header, 10, &info));
+
+  /* a sub-object claiming to be bigger than the header object */
+  header = gst_buffer_make_writable (header);
+  gst_buffer_map (header, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT64_LE (map.data + 30 + 16, header_size);
+  gst_buffer_unmap (header, &map);
+  fail_unless (!probe_buffer (header, header_size, &info));
+
+  /* not a header object at all */
+  gst_buffer_map (header, &map, GST_MAP_WRITE);
+  map.data[0] ^= 0xff;
+  gst_buffer_unmap (header, &map);
+  fail_unless (!probe_buffer (header, header_size, &info));
+  fail_unless_equals_uint64 (info.header_size, 0);
+
+  gst_buffer_unref (header);
+}
+
+GST_END_TEST;
+
+static Suite *
+asfdemux_suite (void)
+{
+  Suite *s = suite_create ("asfdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  GST_DEBUG_CATEGORY_INIT (asfdemux_dbg, "asfdemux", 0, "asf demuxer element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_packet_layouts);
+  tcase_add_test (tc_chain, test_compressed_payloads);
+  tcase_add_test (tc_chain, test_corrupt_packets);
+  tcase_add_test (tc_chain, test_unfragmented_no_allocations);
+  tcase_add_test (tc_chain, test_push_seek_index);
+  tcase_add_test (tc_chain, test_push_seek_stream_index);
+  tcase_add_test (tc_chain, test_index_cache);
+  tcase_add_test (tc_chain, test_pull_read_ahead);
+  tcase_add_test (tc_chain, test_reverse_fragments);
+  tcase_add_test (tc_chain, test_chained_header_keeps_pads);
+  tcase_add_test (tc_chain, test_mbr_pruning);
+  tcase_add_test (tc_chain, test_interleave_streams);
+  tcase_add_test (tc_chain, test_probe_header);
+  tcase_add_test (tc_chain, test_many_fragments);
+  tcase_add_test (tc_chain, test_descrambling);
+  tcase_add_test (tc_chain, test_buffer_list);
+
+  return s;
+}
+
+GST_CHECK_MAIN (asfdemux);
@@ -0,0 +1,669 @@
+/* GStreamer
+ *
+ * asfdemux.h: generated ASF streams for the asfdemux tests and benchmarks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The files have a single 16 bit mono PCM stream. Data packets are
+ * generated so every combination of the variable length fields in packet
+ * and payload headers can be covered. */
+
+#ifndef __ASFDEMUX_TEST_H__
+#define __ASFDEMUX_TEST_H__
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+#include <gst/base/gstbytewriter.h>
+
+#define PACKET_SIZE  256
+#define STREAM_ID    1
+
+/* little endian GUIDs, in the same layout the demuxer reads them in */
+static const guint32 guid_header[4] =
+    { 0x75B22630, 0x11CF668E, 0xAA00D9A6, 0x6CCE6200 };
+static const guint32 guid_file[4] =
+    { 0x8CABDCA1, 0x11CFA947, 0xC000E48E, 0x6553200C };
+static const guint32 guid_stream[4] =
+    { 0xB7DC0791, 0x11CFA9B7, 0xC000E68E, 0x6553200C };
+static const guint32 guid_data[4] =
+    { 0x75b22636, 0x11cf668e, 0xAA00D9a6, 0x6Cce6200 };
+static const guint32 guid_audio[4] =
+    { 0xF8699E40, 0x11CF5B4D, 0x8000FDA8, 0x2B445C5F };
+static const guint32 guid_video[4] =
+    { 0xBC19EFC0, 0x11CF5B4D, 0x8000FDA8, 0x2B445C5F };
+static const guint32 guid_correction_on[4] =
+    { 0xBFC3CD50, 0x11CF618F, 0xAA00B28B, 0x20E2B400 };
+static const guint32 guid_correction_off[4] =
+    { 0x20FB5700, 0x11CF5B55, 0x8000FDA8, 0x2B445C5F };
+static const guint32 guid_simple_index[4] =
+    { 0x33000890, 0x11cfe5b1, 0xA000F489, 0xCB4903c9 };
+static const guint32 guid_index[4] =
+    { 0xd6e229d3, 0x11d135da, 0xa0003490, 0xbe4903c9 };
+static const guint32 guid_bitrate_props[4] =
+    { 0x7bf875ce, 0x11d1468d, 0x6000828d, 0xb2a2c997 };
+static const guint32 guid_header_ext[4] =
+    { 0x5fbf03b5, 0x11cfa92e, 0xC000E38e, 0x6553200c };
+static const guint32 guid_header_ext_reserved[4] =
+    { 0xabd3d211, 0x11cfa9ba, 0xC000E68e, 0x6553200c };
+static const guint32 guid_mutual_exclusion[4] =
+    { 0xa08649cf, 0x46704775, 0x356e168a, 0xcd667535 };
+static const guint32 guid_mutex_bitrate[4] =
+    { 0xd6e22a01, 0x11d135da, 0xa0003490, 0xbe4903c9 };
+
+/* how the variable length fields of a packet are written; each type is
+ * 0 (field not present), 1 (8 bits), 2 (16 bits) or 3 (32 bits) */
+typedef struct
+{
+  guint length_type;
+  guint sequence_type;
+  guint padding_type;
+  guint mo_number_type;
+  guint mo_offset_type;
+  guint rep_data_type;          /* 1-3, there is always replicated data */
+  guint payload_length_type;    /* 1-3, for multiple payloads only */
+  guint num_payloads;           /* 0 for a single payload */
+  gboolean compressed;
+} PacketLayout;
+
+static const guint varlen_sizes[4] = { 0, 1, 2, 4 };
+
+static void
+put_guid (GstByteWriter * bw, const guint32 * guid)
+{
+  gint i;
+
+  for (i = 0; i < 4; ++i)
+    gst_byte_writer_put_uint32_le (bw, guid[i]);
+}
+
+static void
+put_varlen (GstByteWriter * bw, guint type, guint32 val)
+{
+  switch (type) {
+    case 0:
+      g_assert_cmpint (val, ==, 0);
+      break;
+    case 1:
+      gst_byte_writer_put_uint8 (bw, val);
+      break;
+    case 2:
+      gst_byte_writer_put_uint16_le (bw, val);
+      break;
+    case 3:
+      gst_byte_writer_put_uint32_le (bw, val);
+      break;
+    default:
+      g_assert_not_reached ();
+  }
+}
+
+/* a stream of the generated files */
+typedef struct
+{
+  guint id;
+  gboolean video;
+  /* for audio with error correction, which is off for a span of 0 */
+  guint span;
+  guint ds_packet_size;
+  guint ds_chunk_size;
+} StreamDesc;
+
+/* one 16 bit mono PCM stream */
+static const StreamDesc default_streams[] = {
+  {STREAM_ID, FALSE, 0, 0, 0},
+};
+
+static guint
+begin_object (GstByteWriter * bw, const guint32 * guid)
+{
+  guint start = gst_byte_writer_get_pos (bw);
+
+  put_guid (bw, guid);
+  /* size, filled in by end_object */
+  gst_byte_writer_put_uint64_le (bw, 0);
+
+  return start;
+}
+
+static void
+end_object (GstByteWriter * bw, guint start)
+{
+  guint end = gst_byte_writer_get_pos (bw);
+
+  gst_byte_writer_set_pos (bw, start + 16);
+  gst_byte_writer_put_uint64_le (bw, end - start);
+  gst_byte_writer_set_pos (bw, end);
+}
+
+static void
+put_stream_object (GstByteWriter * bw, const StreamDesc * desc)
+{
+  guint start;
+
+  start = begin_object (bw, guid_stream);
+  if (desc->video) {
+    put_guid (bw, guid_video);
+    put_guid (bw, guid_correction_off);
+    gst_byte_writer_put_uint64_le (bw, 0);
+    gst_byte_writer_put_uint32_le (bw, 11 + 40);
+    gst_byte_writer_put_uint32_le (bw, 0);
+    gst_byte_writer_put_uint16_le (bw, desc->id);
+    gst_byte_writer_put_uint32_le (bw, 0);
+    /* 320x240 WMV2 without codec data */
+    gst_byte_writer_put_uint32_le (bw, 320);
+    gst_byte_writer_put_uint32_le (bw, 240);
+    gst_byte_writer_put_uint8 (bw, 0x02);
+    gst_byte_writer_put_uint16_le (bw, 40);
+    gst_byte_writer_put_uint32_le (bw, 40);
+    gst_byte_writer_put_uint32_le (bw, 320);
+    gst_byte_writer_put_uint32_le (bw, 240);
+    gst_byte_writer_put_uint16_le (bw, 1);
+    gst_byte_writer_put_uint16_le (bw, 24);
+    gst_byte_writer_put_data (bw, (const guint8 *) "WMV2", 4);
+    gst_byte_writer_fill (bw, 0, 4 * 5);
+  } else {
+    put_guid (bw, guid_audio);
+    put_guid (bw, desc->span ? guid_correction_on : guid_correction_off);
+    gst_byte_writer_put_uint64_le (bw, 0);
+    gst_byte_writer_put_uint32_le (bw, 18);
+    gst_byte_writer_put_uint32_le (bw, desc->span ? 8 : 0);
+    gst_byte_writer_put_uint16_le (bw, desc->id);
+    gst_byte_writer_put_uint32_le (bw, 0);
+    gst_byte_writer_put_uint16_le (bw, 0x0001); /* PCM */
+    gst_byte_writer_put_uint16_le (bw, 1);
+    gst_byte_writer_put_uint32_le (bw, 8000);
+    gst_byte_writer_put_uint32_le (bw, 16000);
+    gst_byte_writer_put_uint16_le (bw, 2);
+    gst_byte_writer_put_uint16_le (bw, 16);
+    gst_byte_writer_put_uint16_le (bw, 0);
+    if (desc->span) {
+      gst_byte_writer_put_uint8 (bw, desc->span);
+      gst_byte_writer_put_uint16_le (bw, desc->ds_packet_size);
+      gst_byte_writer_put_uint16_le (bw, desc->ds_chunk_size);
+      gst_byte_writer_put_uint16_le (bw, 1);
+      gst_byte_writer_put_uint8 (bw, 0);
+    }
+  }
+  end_object (bw, start);
+}
+
+/* declares all streams as variants of the same content at @bitrates */
+static void
+put_bitrate_variants (GstByteWriter * bw, const StreamDesc * streams,
+    guint num_streams, const guint32 * bitrates)
+{
+  guint start, ext_start, mutex_start, end, i;
+
+  start = begin_object (bw, guid_bitrate_props);
+  gst_byte_writer_put_uint16_le (bw, num_streams);
+  for (i = 0; i < num_streams; ++i) {
+    gst_byte_writer_put_uint16_le (bw, streams[i].id);
+    gst_byte_writer_put_uint32_le (bw, bitrates[i]);
+  }
+  end_object (bw, start);
+
+  start = begin_object (bw, guid_header_ext);
+  put_guid (bw, guid_header_ext_reserved);
+  gst_byte_writer_put_uint16_le (bw, 6);
+  gst_byte_writer_put_uint32_le (bw, 0);
+  ext_start = gst_byte_writer_get_pos (bw);
+
+  mutex_start = begin_object (bw, guid_mutual_exclusion);
+  put_guid (bw, guid_mutex_bitrate);
+  gst_byte_writer_put_uint16_le (bw, num_streams);
+  for (i = 0; i < num_streams; ++i)
+    gst_byte_writer_put_uint16_le (bw, streams[i].id);
+  end_object (bw, mutex_start);
+
+  /* size of the extension data */
+  end = gst_byte_writer_get_pos (bw);
+  gst_byte_writer_set_pos (bw, ext_start - 4);
+  gst_byte_writer_put_uint32_le (bw, end - ext_start);
+  gst_byte_writer_set_pos (bw, end);
+  end_object (bw, start);
+}
+
+/* header object with file properties and the properties of @num_streams
+ * streams, followed by the start of the data object. With @bitrates, the
+ * streams are variants of the same content at those bitrates. */
+static GstBuffer *
+create_header_with_bitrates (const StreamDesc * streams, guint num_streams,
+    const guint32 * bitrates, guint num_packets, guint duration_ms)
+{
+  GstByteWriter bw;
+  guint header_start, file_size_pos, header_size, size, i;
+
+  gst_byte_writer_init (&bw);
+
+  header_start = begin_object (&bw, guid_header);
+  gst_byte_writer_put_uint32_le (&bw, 1 + num_streams + (bitrates ? 2 : 0));
+  gst_byte_writer_put_uint8 (&bw, 0x01);
+  gst_byte_writer_put_uint8 (&bw, 0x02);
+
+  i = begin_object (&bw, guid_file);
+  put_guid (&bw, guid_data);    /* file id, any GUID will do */
+  file_size_pos = gst_byte_writer_get_pos (&bw);
+  gst_byte_writer_put_uint64_le (&bw, 0);
+  gst_byte_writer_put_uint64_le (&bw, 0);
+  gst_byte_writer_put_uint64_le (&bw, num_packets);
+  /* play and send duration, in 100ns units */
+  gst_byte_writer_put_uint64_le (&bw, (guint64) duration_ms * 10000);
+  gst_byte_writer_put_uint64_le (&bw, (guint64) duration_ms * 10000);
+  gst_byte_writer_put_uint64_le (&bw, 0);       /* preroll */
+  gst_byte_writer_put_uint32_le (&bw, 0x02);    /* seekable */
+  gst_byte_writer_put_uint32_le (&bw, PACKET_SIZE);
+  gst_byte_writer_put_uint32_le (&bw, PACKET_SIZE);
+  gst_byte_writer_put_uint32_le (&bw, 128000);
+  end_object (&bw, i);
+
+  for (i = 0; i < num_streams; ++i)
+    put_stream_object (&bw, &streams[i]);
+  if (bitrates)
+    put_bitrate_variants (&bw, streams, num_streams, bitrates);
+
+  end_object (&bw, header_start);
+  header_size = gst_byte_writer_get_pos (&bw);
+
+  gst_byte_writer_set_pos (&bw, file_size_pos);
+  gst_byte_writer_put_uint64_le (&bw, header_size + 50 +
+      (guint64) num_packets * PACKET_SIZE);
+  gst_byte_writer_set_pos (&bw, header_size);
+
+  put_guid (&bw, guid_data);
+  gst_byte_writer_put_uint64_le (&bw, 50 + (guint64) num_packets * PACKET_SIZE);
+  put_guid (&bw, guid_data);
+  gst_byte_writer_put_uint64_le (&bw, num_packets);
+  gst_byte_writer_put_uint8 (&bw, 0x01);
+  gst_byte_writer_put_uint8 (&bw, 0x01);
+
+  size = gst_byte_writer_get_size (&bw);
+  return gst_buffer_new_wrapped (gst_byte_writer_reset_and_get_data (&bw),
+      size);
+}
+
+static GstBuffer *
+create_header_full (const StreamDesc * streams, guint num_streams,
+    guint num_packets, guint duration_ms)
+{
+  return create_header_with_bitrates (streams, num_streams, NULL,
+      num_packets, duration_ms);
+}
+
+static GstBuffer *
+create_header (guint num_packets, guint duration_ms)
+{
+  return create_header_full (default_streams, G_N_ELEMENTS (default_streams),
+      num_packets, duration_ms);
+}
+
+/* simple index object with one entry every @interval_ms */
+static GstBuffer *
+create_simple_index (const guint32 * packets, guint num_entries,
+    guint interval_ms)
+{
+  GstByteWriter bw;
+  guint size = 24 + 16 + 8 + 4 + 4 + num_entries * 6;
+  guint i;
+
+  gst_byte_writer_init (&bw);
+
+  put_guid (&bw, guid_simple_index);
+  gst_byte_writer_put_uint64_le (&bw, size);
+  put_guid (&bw, guid_data);    /* file id */
+  gst_byte_writer_put_uint64_le (&bw, (guint64) interval_ms * 10000);
+  gst_byte_writer_put_uint32_le (&bw, 1);
+  gst_byte_writer_put_uint32_le (&bw, num_entries);
+  for (i = 0; i < num_entries; ++i) {
+    gst_byte_writer_put_uint32_le (&bw, packets[i]);
+    gst_byte_writer_put_uint16_le (&bw, 1);
+  }
+
+  g_assert_cmpint (gst_byte_writer_get_size (&bw), ==, size);
+
+  return gst_buffer_new_wrapped (gst_byte_writer_reset_and_get_data (&bw),
+      size);
+}
+
+/* index object of @type for @num_streams streams, with one entry every
+ * @interval_ms in a single block; @packets has the packet of each stream
+ * for the first entry, then for the second one, and so on */
+static GstBuffer *
+create_index (const StreamDesc * streams, guint num_streams, guint16 type,
+    const guint32 * packets, guint num_entries, guint interval_ms)
+{
+  GstByteWriter bw;
+  guint start, size, i;
+
+  gst_byte_writer_init (&bw);
+
+  start = begin_object (&bw, guid_index);
+  gst_byte_writer_put_uint32_le (&bw, interval_ms);
+  gst_byte_writer_put_uint16_le (&bw, num_streams);
+  gst_byte_writer_put_uint32_le (&bw, 1);
+  for (i = 0; i < num_streams; ++i) {
+    gst_byte_writer_put_uint16_le (&bw, streams[i].id);
+    gst_byte_writer_put_uint16_le (&bw, type);
+  }
+
+  /* block positions, the entries are byte offsets from there */
+  gst_byte_writer_put_uint32_le (&bw, num_entries);
+  for (i = 0; i < num_streams; ++i)
+    gst_byte_writer_put_uint64_le (&bw, 0);
+  for (i = 0; i < num_entries * num_streams; ++i)
+    gst_byte_writer_put_uint32_le (&bw, packets[i] * PACKET_SIZE);
+  end_object (&bw, start);
+
+  size = gst_byte_writer_get_size (&bw);
+  return gst_buffer_new_wrapped (gst_byte_writer_reset_and_get_data (&bw),
+      size);
+}
+
+static void
+put_payload_header (GstByteWriter * bw, const PacketLayout * l,
+    guint32 mo_number, guint32 ts_ms, guint32 mo_size)
+{
+  gst_byte_writer_put_uint8 (bw, STREAM_ID | 0x80);
+  put_varlen (bw, l->mo_number_type, l->mo_number_type ? mo_number : 0);
+
+  if (l->compressed) {
+    /* media object offset is the presentation time, the replicated data the
+     * time between the sub-payloads */
+    put_varlen (bw, l->mo_offset_type, l->mo_offset_type ? ts_ms : 0);
+    put_varlen (bw, l->rep_data_type, 1);
+    gst_byte_writer_put_uint8 (bw, 1);
+  } else {
+    put_varlen (bw, l->mo_offset_type, 0);
+    put_varlen (bw, l->rep_data_type, 8);
+    gst_byte_writer_put_uint32_le (bw, mo_size);
+    gst_byte_writer_put_uint32_le (bw, ts_ms);
+  }
+}
+
+/* size of the media object data in a payload with @len bytes of data */
+static guint
+payload_data_size (const PacketLayout * l, guint len)
+{
+  /* 4 sub-payloads of the same size with a length byte each */
+  return l->compressed ? (len / 4 - 1) * 4 : len;
+}
+
+static void
+put_payload_data (GstByteWriter * bw, const PacketLayout * l, guint len,
+    guint8 fill)
+{
+  if (l->compressed) {
+    guint i;
+
+    for (i = 0; i < 4; ++i) {
+      gst_byte_writer_put_uint8 (bw, len / 4 - 1);
+      gst_byte_writer_fill (bw, fill, len / 4 - 1);
+    }
+    gst_byte_writer_fill (bw, 0, len % 4);
+  } else {
+    gst_byte_writer_fill (bw, fill, len);
+  }
+}
+
+/* creates a data packet according to @l. @mo_number is the number of the
+ * first media object in the packet and is advanced by the number of media
+ * objects in it. The number of buffers the demuxer should output for the
+ * packet is stored in @p_buffers, their total size in @p_bytes. */
+static GstBuffer *
+create_packet (const PacketLayout * l, guint32 * mo_number,
+    guint * p_buffers, guint * p_bytes)
+{
+  GstByteWriter bw, pw;
+  guint header_len, padding, length, len, i, size, num;
+  guint8 flags1, prop_flags, *payloads;
+
+  header_len = 2 + varlen_sizes[l->length_type] +
+      varlen_sizes[l->sequence_type] + varlen_sizes[l->padding_type] + 6;
+
+  gst_byte_writer_init (&pw);
+  *p_buffers = 0;
+  *p_bytes = 0;
+
+  if (l->num_payloads == 0) {
+    put_payload_header (&pw, l, *mo_number, *mo_number * 10, 0);
+    /* a single payload always fills the packet, patch up the size */
+    len = PACKET_SIZE - header_len - gst_byte_writer_get_size (&pw);
+    if (!l->compressed) {
+      gst_byte_writer_set_pos (&pw, gst_byte_writer_get_size (&pw) - 8);
+      gst_byte_writer_put_uint32_le (&pw, len);
+      gst_byte_writer_set_pos (&pw, gst_byte_writer_get_size (&pw));
+    }
+    put_payload_data (&pw, l, len, *mo_number & 0xff);
+    *p_buffers += l->compressed ? 4 : 1;
+    *p_bytes += payload_data_size (l, len);
+    *mo_number += 1;
+  } else {
+    num = l->num_payloads;
+    gst_byte_writer_put_uint8 (&pw, num | (l->payload_length_type << 6));
+    for (i = 0; i < num; ++i) {
+      len = 32 + 4 * i;
+      put_payload_header (&pw, l, *mo_number, *mo_number * 10, len);
+      put_varlen (&pw, l->payload_length_type, len);
+      put_payload_data (&pw, l, len, *mo_number & 0xff);
+      *p_buffers += l->compressed ? 4 : 1;
+      *p_bytes += payload_data_size (l, len);
+      *mo_number += 1;
+    }
+  }
+
+  g_assert (header_len + gst_byte_writer_get_size (&pw) <= PACKET_SIZE);
+  padding = PACKET_SIZE - header_len - gst_byte_writer_get_size (&pw);
+
+  flags1 = (l->num_payloads > 0 ? 0x01 : 0x00) | (l->sequence_type << 1) |
+      (l->padding_type << 3) | (l->length_type << 5);
+  prop_flags = l->rep_data_type | (l->mo_offset_type << 2) |
+      (l->mo_number_type << 4) | (0x01 << 6);
+
+  gst_byte_writer_init_with_size (&bw, PACKET_SIZE, TRUE);
+  gst_byte_writer_put_uint8 (&bw, flags1);
+  gst_byte_writer_put_uint8 (&bw, prop_flags);
+  /* without a padding field, leftover space in packets with several
+   * payloads is declared through the packet length, or ignored. A length of
+   * 0 means it's not specified. */
+  length = 0;
+  if (l->length_type != 0) {
+    length = l->padding_type ? PACKET_SIZE : PACKET_SIZE - padding;
+    if (length > G_MAXUINT8 && l->length_type == 1)
+      length = 0;
+  }
+  put_varlen (&bw, l->length_type, length);
+  put_varlen (&bw, l->sequence_type, 0);
+  put_varlen (&bw, l->padding_type, l->padding_type ? padding : 0);
+  gst_byte_writer_put_uint32_le (&bw, 0);       /* send time */
+  gst_byte_writer_put_uint16_le (&bw, 10);      /* duration */
+  len = gst_byte_writer_get_size (&pw);
+  payloads = gst_byte_writer_reset_and_get_data (&pw);
+  gst_byte_writer_put_data (&bw, payloads, len);
+  g_free (payloads);
+  gst_byte_writer_fill (&bw, 0, padding);
+
+  size = gst_byte_writer_get_size (&bw);
+  g_assert_cmpint (size, ==, PACKET_SIZE);
+
+  return gst_buffer_new_wrapped (gst_byte_writer_reset_and_get_data (&bw),
+      size);
+}
+
+/* byte @offset of media object @mo_number in the fragment packets */
+#define FRAGMENT_BYTE(mo_number, offset)  (((mo_number) * 7 + (offset)) & 0xff)
+
+/* the most media object data a fragment packet can carry */
+#define FRAGMENT_MAX_LEN  (PACKET_SIZE - 10 - 15)
+
+/* creates a packet with a single payload for @stream_id, carrying @len bytes
+ * at @offset of media object @mo_number, which is @mo_size bytes big and
+ * starts at @ts_ms. The data is made up of FRAGMENT_BYTE()s. */
+static GstBuffer *
+create_fragment_packet (guint stream_id, guint32 mo_number, guint32 ts_ms,
+    guint32 mo_size, guint32 offset, guint len, gboolean keyframe)
+{
+  GstByteWriter bw;
+  guint i, padding;
+
+  g_assert (len <= FRAGMENT_MAX_LEN);
+  padding = FRAGMENT_MAX_LEN - len;
+
+  gst_byte_writer_init_with_size (&bw, PACKET_SIZE, TRUE);
+  /* 16 bit padding length, single payload */
+  gst_byte_writer_put_uint8 (&bw, 0x02 << 3);
+  /* 8 bit media object number, 32 bit offset and 8 bit replicated data
+   * length */
+  gst_byte_writer_put_uint8 (&bw, 0x01 | (0x03 << 2) | (0x01 << 4) |
+      (0x01 << 6));
+  gst_byte_writer_put_uint16_le (&bw, padding);
+  gst_byte_writer_put_uint32_le (&bw, ts_ms);   /* send time */
+  gst_byte_writer_put_uint16_le (&bw, 10);      /* duration */
+
+  gst_byte_writer_put_uint8 (&bw, stream_id | (keyframe ? 0x80 : 0));
+  gst_byte_writer_put_uint8 (&bw, mo_number & 0xff);
+  gst_byte_writer_put_uint32_le (&bw, offset);
+  gst_byte_writer_put_uint8 (&bw, 8);
+  gst_byte_writer_put_uint32_le (&bw, mo_size);
+  gst_byte_writer_put_uint32_le (&bw, ts_ms);
+  for (i = 0; i < len; ++i)
+    gst_byte_writer_put_uint8 (&bw, FRAGMENT_BYTE (mo_number, offset + i));
+  gst_byte_writer_fill (&bw, 0, padding);
+
+  g_assert_cmpint (gst_byte_writer_get_size (&bw), ==, PACKET_SIZE);
+
+  return gst_buffer_new_wrapped (gst_byte_writer_reset_and_get_data (&bw),
+      PACKET_SIZE);
+}
+
+/* audio with error correction, the last one has a packet size that isn't a
+ * multiple of the chunk size */
+static const StreamDesc descramble_streams[] = {
+  {STREAM_ID, FALSE, 3, 60, 20},
+  {STREAM_ID, FALSE, 2, 100, 25},
+  {STREAM_ID, FALSE, 4, 50, 20},
+};
+
+/* output chunk row * span + col is input chunk
+ * row + col * packet_size / chunk_size */
+static void
+descramble_reference (const StreamDesc * desc, const guint8 * in,
+    guint8 * out, guint size)
+{
+  guint chunk_size = desc->ds_chunk_size;
+  guint n;
+
+  for (n = 0; n < size / chunk_size; ++n) {
+    guint row = n / desc->span;
+    guint col = n % desc->span;
+    guint idx = row + col * desc->ds_packet_size / chunk_size;
+
+    memcpy (out + n * chunk_size, in + idx * chunk_size, chunk_size);
+  }
+}
+
+/* the harness gets the first pad; with more streams, tests watch the other
+ * pads with probes */
+static void
+pad_added_cb (GstElement * demux, GstPad * pad, GstHarness * h)
+{
+  if (h->sinkpad == NULL)
+    gst_harness_add_element_src_pad (h, pad);
+}
+
+/* a demuxer in push mode that is waiting for the header */
+static GstHarness *
+setup_asfdemux_without_header (void)
+{
+  GstHarness *h;
+  GstSegment segment;
+
+  h = gst_harness_new_with_padnames ("asfdemux", "sink", NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (pad_added_cb), h);
+
+  gst_harness_push_event (h, gst_event_new_stream_start ("asfdemux-test"));
+  gst_harness_push_event (h,
+      gst_event_new_caps (gst_caps_new_empty_simple ("video/x-ms-asf")));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_harness_push_event (h, gst_event_new_segment (&segment));
+
+  return h;
+}
+
+static GstHarness *
+setup_asfdemux_with_header (GstBuffer * header)
+{
+  GstHarness *h;
+  GstFlowReturn ret;
+
+  h = setup_asfdemux_without_header ();
+
+  ret = gst_harness_push (h, header);
+  g_assert_cmpint (ret, ==, GST_FLOW_OK);
+
+  return h;
+}
+
+static GstHarness *
+setup_asfdemux_with_duration (guint num_packets, guint duration_ms)
+{
+  return setup_asfdemux_with_header (create_header (num_packets,
+          duration_ms));
+}
+
+/* one media object every 10 ms */
+static GstHarness *
+setup_asfdemux (guint num_packets)
+{
+  return setup_asfdemux_with_duration (num_packets, num_packets * 10);
+}
+
+static guint
+layout_count (gboolean compressed)
+{
+  return 4 * 4 * 4 * 4 * 4 * 3 * 4 / (compressed ? 4 : 1);
+}
+
+/* enumerates all combinations of length types, with single and multiple
+ * payloads; compressed payloads need the media object offset field to store
+ * the timestamp in, so type 0 is left out for those */
+static void
+layout_init (PacketLayout * l, guint n, gboolean compressed)
+{
+  memset (l, 0, sizeof (PacketLayout));
+
+  l->compressed = compressed;
+  l->length_type = n % 4;
+  n /= 4;
+  l->sequence_type = n % 4;
+  n /= 4;
+  l->padding_type = n % 4;
+  n /= 4;
+  l->mo_number_type = n % 4;
+  n /= 4;
+  if (compressed) {
+    l->mo_offset_type = 3;
+  } else {
+    l->mo_offset_type = n % 4;
+    n /= 4;
+  }
+  l->rep_data_type = 1 + n % 3;
+  n /= 3;
+  l->num_payloads = n % 4;
+  l->payload_length_type = 1 + (n + l->mo_number_type) % 3;
+}
+
+#endif /* __ASFDEMUX_TEST_H__ */
@@ -0,0 +1,424 @@
+/* GStreamer
+ *
+ * rdtmanager.c: Unit test for the rdtmanager element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The sender is simulated by the tests: it drops packets and answers the
+ * retransmission requests coming out of the rtcp_src pad, as a server would
+ * over UDP. Which packets are requested only depends on the packets pushed
+ * in and their arrival times, not on how far the src pad task got. */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/check/gsttestclock.h>
+
+#define NUM_PACKETS       20
+#define PACKET_DURATION   (10 * GST_MSECOND)
+#define ACK_HEADER_SIZE   11
+
+static GstBuffer *
+create_data_packet (guint16 seqnum)
+{
+  guint8 *data;
+
+  /* no length included, stream 0, asm rule 0 */
+  data = g_malloc0 (16);
+  GST_WRITE_UINT16_BE (&data[1], seqnum);
+  GST_WRITE_UINT32_BE (&data[4], seqnum * 10);
+
+  return gst_buffer_new_wrapped (data, 16);
+}
+
+static GstFlowReturn
+send_packet (GstHarness * h, guint16 seqnum, GstClockTime arrival)
+{
+  GstBuffer *buf;
+
+  buf = create_data_packet (seqnum);
+  GST_BUFFER_PTS (buf) = arrival;
+
+  return gst_harness_push (h, buf);
+}
+
+static GstCaps *
+request_pt_map_cb (GstElement * element, guint session, guint pt,
+    gpointer user_data)
+{
+  return gst_caps_new_simple ("application/x-pn-realrtsp",
+      "clock-rate", G_TYPE_INT, 1000, NULL);
+}
+
+static void
+pad_added_cb (GstElement * element, GstPad * pad, GstHarness * h)
+{
+  gst_harness_add_element_src_pad (h, pad);
+}
+
+static GstHarness *
+setup_rdtmanager (GstHarness ** rtcp)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("rdtmanager", "recv_rtp_sink_0", NULL);
+  g_signal_connect (h->element, "request-pt-map",
+      G_CALLBACK (request_pt_map_cb), NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (pad_added_cb), h);
+  g_object_set (h->element, "do-retransmission", TRUE,
+      "retransmission-interval", 100, NULL);
+  gst_harness_set_src_caps_str (h, "application/x-rdt, clock-rate=1000");
+
+  *rtcp = gst_harness_new_with_element (h->element, NULL, "rtcp_src_0");
+
+  return h;
+}
+
+/* answers the ack packets pulled from @rtcp by resending the requested
+ * packets, which are also added to @requested. Returns the number of ack
+ * packets. */
+static guint
+answer_acks (GstHarness * h, GstHarness * rtcp, GstClockTime arrival,
+    gboolean resend, GArray * requested)
+{
+  GstBuffer *ack;
+  guint num_acks = 0;
+
+  while ((ack = gst_harness_try_pull (rtcp))) {
+    GstMapInfo map;
+    guint16 first, count, i;
+
+    fail_unless (gst_buffer_map (ack, &map, GST_MAP_READ));
+    fail_unless (map.size >= ACK_HEADER_SIZE);
+    /* length included and lost_high */
+    fail_unless_equals_int (map.data[0], 0xc0);
+    fail_unless_equals_int (GST_READ_UINT16_BE (&map.data[1]), 0xff02);
+    fail_unless_equals_int (GST_READ_UINT16_BE (&map.data[3]), map.size);
+    first = GST_READ_UINT16_BE (&map.data[7]);
+    count = GST_READ_UINT16_BE (&map.data[9]);
+    fail_unless (count > 0);
+    fail_unless_equals_int (map.size, ACK_HEADER_SIZE + (count + 7) / 8);
+
+    for (i = 0; i < count; i++) {
+      guint16 seqnum = first + i;
+
+      if (!(map.data[ACK_HEADER_SIZE + i / 8] & (0x80 >> (i % 8))))
+        continue;
+      g_array_append_val (requested, seqnum);
+      if (resend)
+        fail_unless_equals_int (send_packet (h, seqnum, arrival), GST_FLOW_OK);
+    }
+    gst_buffer_unmap (ack, &map);
+    gst_buffer_unref (ack);
+    num_acks++;
+  }
+  return num_acks;
+}
+
+static void
+check_requested (GArray * requested, const guint16 * expected, guint len)
+{
+  guint i;
+
+  fail_unless_equals_int (requested->len, len);
+  for (i = 0; i < len; i++)
+    fail_unless_equals_int (g_array_index (requested, guint16, i), expected[i]);
+}
+
+static gboolean
+is_dropped (guint16 seqnum)
+{
+  return seqnum == 3 || seqnum == 10 || seqnum == 11;
+}
+
+GST_START_TEST (test_retransmission)
+{
+  static const guint16 expected[] = { 3, 10, 11 };
+  GstHarness *h, *rtcp;
+  GArray *requested;
+  gboolean received[NUM_PACKETS] = { FALSE, };
+  guint16 seqnum;
+  guint i, num_acks = 0;
+
+  h = setup_rdtmanager (&rtcp);
+  requested = g_array_new (FALSE, FALSE, sizeof (guint16));
+
+  for (seqnum = 0; seqnum < NUM_PACKETS; seqnum++) {
+    GstClockTime arrival = seqnum * PACKET_DURATION;
+
+    if (!is_dropped (seqnum))
+      fail_unless_equals_int (send_packet (h, seqnum, arrival), GST_FLOW_OK);
+    num_acks += answer_acks (h, rtcp, arrival, TRUE, requested);
+  }
+  /* one for #3 at 40ms, #10 and #11 are seen missing at 120ms but only
+   * requested at 140ms, when the interval allows the next ack */
+  fail_unless_equals_int (num_acks, 2);
+  check_requested (requested, expected, G_N_ELEMENTS (expected));
+
+  /* everything arrives in the end */
+  for (i = 0; i < NUM_PACKETS; i++) {
+    GstBuffer *buf;
+    GstMapInfo map;
+
+    buf = gst_harness_pull (h);
+    fail_unless (buf != NULL);
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    seqnum = GST_READ_UINT16_BE (&map.data[1]);
+    fail_unless (seqnum < NUM_PACKETS);
+    fail_if (received[seqnum]);
+    received[seqnum] = TRUE;
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  g_array_free (requested, TRUE);
+  gst_harness_teardown (rtcp);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_retransmission_rate_limit)
+{
+  static const guint16 expected[] = { 1, 3, 5, 7, 9, 11 };
+  GstHarness *h, *rtcp;
+  GArray *requested;
+  guint16 seqnum;
+  guint num_acks = 0;
+
+  h = setup_rdtmanager (&rtcp);
+  requested = g_array_new (FALSE, FALSE, sizeof (guint16));
+
+  /* every other packet is lost and never resent, a gap shows up with each
+   * packet but it is only reported every 100ms */
+  for (seqnum = 0; seqnum < NUM_PACKETS; seqnum += 2) {
+    GstClockTime arrival = seqnum * PACKET_DURATION;
+
+    fail_unless_equals_int (send_packet (h, seqnum, arrival), GST_FLOW_OK);
+    num_acks += answer_acks (h, rtcp, arrival, FALSE, requested);
+  }
+  /* #1 at 20ms, then #3 to #11 together at 120ms; the later losses wait
+   * for the next interval */
+  fail_unless_equals_int (num_acks, 2);
+  check_requested (requested, expected, G_N_ELEMENTS (expected));
+
+  g_array_free (requested, TRUE);
+  gst_harness_teardown (rtcp);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* a session without retransmission, in @mode, on a test clock */
+static GstHarness *
+setup_rdtmanager_with_mode (const gchar * mode)
+{
+  GstHarness *h;
+
+  h = gst_harness_new_with_padnames ("rdtmanager", "recv_rtp_sink_0", NULL);
+  g_signal_connect (h->element, "request-pt-map",
+      G_CALLBACK (request_pt_map_cb), NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (pad_added_cb), h);
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode", mode);
+  gst_harness_use_testclock (h);
+  gst_harness_set_src_caps_str (h, "application/x-rdt, clock-rate=1000");
+
+  return h;
+}
+
+static guint16
+pull_seqnum (GstHarness * h)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint16 seqnum;
+
+  buf = gst_harness_pull (h);
+  fail_unless (buf != NULL);
+  fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+  seqnum = GST_READ_UINT16_BE (&map.data[1]);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  return seqnum;
+}
+
+static guint64
+get_session_stat (GstHarness * h, const gchar * field)
+{
+  GstStructure *stats = NULL;
+  const GValue *sessions;
+  const GstStructure *session;
+  guint64 val = 0;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+  sessions = gst_structure_get_value (stats, "sessions");
+  fail_unless (sessions != NULL);
+  fail_unless_equals_int (gst_value_array_get_size (sessions), 1);
+  session = gst_value_get_structure (gst_value_array_get_value (sessions, 0));
+  fail_unless (gst_structure_get_uint64 (session, field, &val));
+  gst_structure_free (stats);
+
+  return val;
+}
+
+/* a gap holds back the packets after it for the latency, then the missing
+ * packet is declared lost and dropped when it turns up after all */
+GST_START_TEST (test_reorder_mode)
+{
+  GstHarness *h;
+  GstClockID id;
+
+  h = setup_rdtmanager_with_mode ("reorder");
+
+  fail_unless_equals_int (send_packet (h, 0, 0), GST_FLOW_OK);
+  fail_unless_equals_int (pull_seqnum (h), 0);
+
+  /* #1 is missing, #2 waits for it until its arrival time plus latency */
+  fail_unless_equals_int (send_packet (h, 2, 2 * PACKET_DURATION),
+      GST_FLOW_OK);
+  gst_test_clock_wait_for_next_pending_id (GST_TEST_CLOCK (h->testclock),
+      &id);
+  fail_unless_equals_uint64 (gst_clock_id_get_time (id),
+      2 * PACKET_DURATION + 200 * GST_MSECOND);
+  gst_clock_id_unref (id);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+  fail_unless_equals_int (pull_seqnum (h), 2);
+  fail_unless_equals_uint64 (get_session_stat (h, "packets-lost"), 1);
+
+  /* too late now, #1 is dropped and #3 goes out right away */
+  fail_unless_equals_int (send_packet (h, 1, 230 * GST_MSECOND),
+      GST_FLOW_OK);
+  fail_unless_equals_int (send_packet (h, 3, 240 * GST_MSECOND),
+      GST_FLOW_OK);
+  fail_unless_equals_int (pull_seqnum (h), 3);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+  fail_unless_equals_uint64 (get_session_stat (h, "packets-late"), 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* without reordering, packets go out as they arrive, gap or not */
+GST_START_TEST (test_low_latency_mode)
+{
+  GstHarness *h;
+
+  h = setup_rdtmanager_with_mode ("low-latency");
+
+  fail_unless_equals_int (send_packet (h, 0, 0), GST_FLOW_OK);
+  fail_unless_equals_int (pull_seqnum (h), 0);
+  fail_unless_equals_int (send_packet (h, 2, 2 * PACKET_DURATION),
+      GST_FLOW_OK);
+  fail_unless_equals_int (pull_seqnum (h), 2);
+  fail_unless_equals_int (send_packet (h, 1, 3 * PACKET_DURATION),
+      GST_FLOW_OK);
+  fail_unless_equals_int (pull_seqnum (h), 1);
+
+  /* the clock was never waited on */
+  fail_if (gst_test_clock_peek_next_pending_id (GST_TEST_CLOCK
+          (h->testclock), NULL));
+  fail_unless_equals_uint64 (get_session_stat (h, "packets-late"), 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* sends packet @seqnum as the @n-th one, at its arrival time */
+static GstFlowReturn
+send_nth_packet (GstHarness * h, guint16 seqnum, guint n)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+
+  buf = create_data_packet (seqnum);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  GST_WRITE_UINT32_BE (&map.data[4], n * 10);
+  gst_buffer_unmap (buf, &map);
+  GST_BUFFER_PTS (buf) = n * PACKET_DURATION;
+
+  return gst_harness_push (h, buf);
+}
+
+/* the sequence numbers wrap around while the queue grows past its initial
+ * size, then duplicates, late and lost packets show up in the stats */
+GST_START_TEST (test_stats)
+{
+  GstHarness *h;
+  guint16 first = 65500, seqnum;
+  guint n, num = 100;
+
+  h = setup_rdtmanager_with_mode ("reorder");
+
+  fail_unless_equals_int (send_nth_packet (h, first, 0), GST_FLOW_OK);
+  fail_unless_equals_int (pull_seqnum (h), first);
+
+  /* without the second packet, everything after it is held back */
+  for (n = 2; n < num; n++)
+    fail_unless_equals_int (send_nth_packet (h, first + n, n), GST_FLOW_OK);
+  /* already queued */
+  fail_unless_equals_int (send_nth_packet (h, first + 10, 10), GST_FLOW_OK);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  fail_unless_equals_int (send_nth_packet (h, first + 1, 1), GST_FLOW_OK);
+  for (n = 1; n < num; n++) {
+    seqnum = first + n;
+    fail_unless_equals_int (pull_seqnum (h), seqnum);
+  }
+
+  /* the last one pushed out again, and an older one */
+  fail_unless_equals_int (send_nth_packet (h, seqnum, num), GST_FLOW_OK);
+  fail_unless_equals_int (send_nth_packet (h, seqnum - 3, num), GST_FLOW_OK);
+  /* the next one goes missing */
+  fail_unless_equals_int (send_nth_packet (h, seqnum + 2, num + 1),
+      GST_FLOW_OK);
+  fail_unless (gst_harness_crank_single_clock_wait (h));
+  fail_unless_equals_int (pull_seqnum (h), (guint16) (seqnum + 2));
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  fail_unless_equals_uint64 (get_session_stat (h, "packets-received"),
+      num + 2);
+  fail_unless_equals_uint64 (get_session_stat (h, "duplicates"), 2);
+  fail_unless_equals_uint64 (get_session_stat (h, "packets-late"), 1);
+  fail_unless_equals_uint64 (get_session_stat (h, "packets-lost"), 1);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+rdtmanager_suite (void)
+{
+  Suite *s = suite_create ("rdtmanager");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_retransmission);
+  tcase_add_test (tc_chain, test_retransmission_rate_limit);
+  tcase_add_test (tc_chain, test_reorder_mode);
+  tcase_add_test (tc_chain, test_low_latency_mode);
+  tcase_add_test (tc_chain, test_stats);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rdtmanager);
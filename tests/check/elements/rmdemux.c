@@ -0,0 +1,428 @@
+/* GStreamer
+ *
+ * rmdemux.c: Unit test for the rmdemux element
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The streams used here are generated, see rmdemux.h; the demuxer output is
+ * compared against descrambling them the straightforward way. */
+
+#include <gst/check/gstcheck.h>
+
+#include "rmdemux.h"
+
+static guint
+get_stat (GstHarness * h, const gchar * field)
+{
+  GstStructure *stats = NULL;
+  guint val = 0;
+
+  g_object_get (h->element, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+  fail_unless (gst_structure_get_uint (stats, field, &val));
+  gst_structure_free (stats);
+
+  return val;
+}
+
+static void
+check_layout (const StreamLayout * l)
+{
+  GstHarness *h;
+  GRand *rand;
+  guint8 *payloads, *expected;
+  guint num_blocks = 3, num_bufs, size, b, p;
+
+  GST_INFO ("%s flavor %u, height %u, packet size %u, leaf size %u",
+      l->fourcc, l->flavor, l->height, l->packet_size, l->leaf_size);
+
+  payloads = g_malloc (l->height * l->packet_size);
+  expected = g_malloc (l->height * l->packet_size);
+  rand = g_rand_new_with_seed (l->height);
+
+  h = setup_rmdemux (l, num_blocks);
+
+  for (b = 0; b < num_blocks; ++b) {
+    fail_unless_equals_int (gst_harness_push (h, create_block (l, b, rand,
+                payloads)), GST_FLOW_OK);
+    num_bufs = descramble (l, payloads, expected);
+    size = l->height * l->packet_size / num_bufs;
+
+    for (p = 0; p < num_bufs; ++p) {
+      GstBuffer *buf;
+
+      buf = gst_harness_try_pull (h);
+      fail_unless (buf != NULL);
+      fail_unless_equals_int (gst_buffer_get_size (buf), size);
+      fail_unless (gst_buffer_memcmp (buf, 0, expected + p * size, size) == 0);
+
+      if (p == 0) {
+        fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+            b * l->height * PACKET_DURATION_MS * GST_MSECOND);
+      }
+      fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (buf,
+              GST_BUFFER_FLAG_DISCONT), b == 0 && p == 0);
+      gst_buffer_unref (buf);
+    }
+    fail_unless (gst_harness_try_pull (h) == NULL);
+  }
+
+  gst_harness_teardown (h);
+  g_rand_free (rand);
+  g_free (expected);
+  g_free (payloads);
+}
+
+GST_START_TEST (test_descramble_layouts)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (layouts); ++i)
+    check_layout (&layouts[i]);
+}
+
+GST_END_TEST;
+
+/* checks that the output buffers are recycled instead of allocated once
+ * downstream is done with them */
+static void
+check_recycling (const StreamLayout * l)
+{
+  GstHarness *h;
+  GRand *rand;
+  guint8 *payloads, *expected;
+  guint i, num = 20, num_bufs = 0;
+
+  payloads = g_malloc (l->height * l->packet_size);
+  expected = g_malloc (l->height * l->packet_size);
+  rand = g_rand_new_with_seed (0);
+
+  h = setup_rmdemux (l, num);
+
+  for (i = 0; i < num; ++i) {
+    GstBuffer *buf;
+
+    fail_unless_equals_int (gst_harness_push (h, create_block (l, i, rand,
+                payloads)), GST_FLOW_OK);
+    while ((buf = gst_harness_try_pull (h))) {
+      gst_buffer_unref (buf);
+      ++num_bufs;
+    }
+  }
+
+  fail_unless_equals_int (num_bufs, num * descramble (l, payloads, expected));
+  fail_unless_equals_int (get_stat (h, "buffers-allocated"), 0);
+
+  gst_harness_teardown (h);
+  g_rand_free (rand);
+  g_free (expected);
+  g_free (payloads);
+}
+
+GST_START_TEST (test_buffers_recycled)
+{
+  guint i;
+
+  check_recycling (&layouts[0]);
+  for (i = 0; i < G_N_ELEMENTS (sipr_layouts); ++i)
+    check_recycling (&sipr_layouts[i]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_sipr_flavors)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (sipr_layouts); ++i)
+    check_layout (&sipr_layouts[i]);
+}
+
+GST_END_TEST;
+
+static guint
+count_allocations (GstHarness * h)
+{
+  return get_stat (h, "buffers-allocated") + get_stat (h, "buffers-pooled") +
+      get_stat (h, "buffers-downstream");
+}
+
+/* video frames are output with a header listing the fragment offsets in
+ * front of the fragments */
+static void
+check_video_layout (const StreamLayout * l)
+{
+  GstHarness *h;
+  GRand *rand;
+  guint8 *payloads;
+  guint num_blocks = 3, header_size, frame_size, b, i;
+  gboolean many_fragments;
+
+  GST_INFO ("%s with %u fragments of %u bytes", l->fourcc, l->height,
+      l->packet_size);
+
+  frame_size = l->height * l->packet_size;
+  header_size = 1 + 8 * l->height;
+  many_fragments = l->height >= gst_buffer_get_max_memory ();
+
+  payloads = g_malloc (frame_size);
+  rand = g_rand_new_with_seed (l->height);
+
+  h = setup_rmdemux (l, num_blocks);
+
+  for (b = 0; b < num_blocks; ++b) {
+    GstBuffer *buf;
+    GstMapInfo map;
+    guint allocations;
+
+    allocations = count_allocations (h);
+    fail_unless_equals_int (gst_harness_push (h, create_block (l, b, rand,
+                payloads)), GST_FLOW_OK);
+
+    buf = gst_harness_try_pull (h);
+    fail_unless (buf != NULL);
+    fail_unless (gst_harness_try_pull (h) == NULL);
+
+    fail_unless_equals_int (gst_buffer_get_size (buf),
+        header_size + frame_size);
+    fail_unless_equals_uint64 (GST_BUFFER_DTS (buf),
+        b * l->height * PACKET_DURATION_MS * GST_MSECOND);
+    fail_unless (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+
+    /* more fragments than memories in a buffer are copied into one */
+    if (many_fragments) {
+      fail_unless_equals_int (gst_buffer_n_memory (buf), 1);
+      fail_unless_equals_int (count_allocations (h) - allocations, 1);
+    } else {
+      fail_unless_equals_int (gst_buffer_n_memory (buf), 1 + l->height);
+      fail_unless_equals_int (count_allocations (h) - allocations, 0);
+    }
+
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    fail_unless_equals_int (map.data[0], l->height - 1);
+    for (i = 0; i < l->height; ++i) {
+      fail_unless_equals_int (GST_READ_UINT32_LE (map.data + 1 + 8 * i), 1);
+      fail_unless_equals_int (GST_READ_UINT32_LE (map.data + 5 + 8 * i),
+          i * l->packet_size);
+    }
+    fail_unless (memcmp (map.data + header_size, payloads, frame_size) == 0);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+  g_rand_free (rand);
+  g_free (payloads);
+}
+
+GST_START_TEST (test_video_fragments)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (video_layouts); ++i)
+    check_video_layout (&video_layouts[i]);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  GstBuffer *file;
+  guint64 offset;
+  guint64 max_offset;
+  GMutex lock;
+  GstBuffer *first;
+} RandomAccessSource;
+
+/* appsrc in random-access mode calls this for every pull_range */
+static gboolean
+seek_data_cb (GstElement * appsrc, guint64 offset, RandomAccessSource * src)
+{
+  g_mutex_lock (&src->lock);
+  src->offset = offset;
+  g_mutex_unlock (&src->lock);
+
+  return TRUE;
+}
+
+static void
+need_data_cb (GstElement * appsrc, guint length, RandomAccessSource * src)
+{
+  gsize size = gst_buffer_get_size (src->file);
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&src->lock);
+  if (src->offset < size) {
+    length = MIN (length, size - src->offset);
+    buf = gst_buffer_copy_region (src->file, GST_BUFFER_COPY_ALL, src->offset,
+        length);
+    src->offset += length;
+    src->max_offset = MAX (src->max_offset, src->offset);
+  }
+  g_mutex_unlock (&src->lock);
+
+  if (buf != NULL) {
+    g_signal_emit_by_name (appsrc, "push-buffer", buf, &ret);
+    gst_buffer_unref (buf);
+  } else {
+    g_signal_emit_by_name (appsrc, "end-of-stream", &ret);
+  }
+}
+
+static GstPadProbeReturn
+first_buffer_probe (GstPad * pad, GstPadProbeInfo * info,
+    RandomAccessSource * src)
+{
+  g_mutex_lock (&src->lock);
+  if (src->first == NULL)
+    src->first = gst_buffer_ref (GST_PAD_PROBE_INFO_BUFFER (info));
+  g_mutex_unlock (&src->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+link_fakesink_cb (GstElement * demux, GstPad * pad, RandomAccessSource * src)
+{
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  gst_bin_add (GST_BIN (GST_ELEMENT_PARENT (demux)), sink);
+  gst_element_sync_state_with_parent (sink);
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) first_buffer_probe, src, NULL);
+}
+
+/* seeks to @target_ms and checks that the first frame pushed is the one of
+ * @expected_block, and that no more than @max_offset bytes were read */
+static void
+check_pull_seek (GstElement * pipeline, RandomAccessSource * src,
+    const StreamLayout * l, const guint8 * payloads, guint target_ms,
+    guint expected_block, guint64 max_offset)
+{
+  guint frame_size = l->height * l->packet_size;
+  guint header_size = 1 + 8 * l->height;
+  GstMapInfo map;
+
+  g_mutex_lock (&src->lock);
+  gst_buffer_replace (&src->first, NULL);
+  src->max_offset = 0;
+  g_mutex_unlock (&src->lock);
+
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, target_ms * GST_MSECOND));
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  g_mutex_lock (&src->lock);
+  fail_unless (src->first != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_DTS (src->first),
+      expected_block * l->height * PACKET_DURATION_MS * GST_MSECOND);
+  gst_buffer_map (src->first, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, header_size + frame_size);
+  fail_unless (memcmp (map.data + header_size,
+          payloads + expected_block * frame_size, frame_size) == 0);
+  gst_buffer_unmap (src->first, &map);
+  fail_unless (src->max_offset <= max_offset);
+  g_mutex_unlock (&src->lock);
+}
+
+/* a file without INDX chunk is seekable in pull mode, the index is built
+ * from the data packets as far as the seeks need it */
+GST_START_TEST (test_pull_seek_without_index)
+{
+  const StreamLayout *l = &video_layouts[0];
+  RandomAccessSource src = { NULL, };
+  GstElement *pipeline, *appsrc, *demux;
+  GstCaps *caps;
+  GRand *rand;
+  guint8 *payloads;
+  guint num_blocks = 250, frame_size, b;
+  gsize size;
+
+  frame_size = l->height * l->packet_size;
+  payloads = g_malloc (num_blocks * frame_size);
+  rand = g_rand_new_with_seed (0);
+
+  src.file = create_header (l, num_blocks * l->height);
+  for (b = 0; b < num_blocks; ++b)
+    src.file = gst_buffer_append (src.file, create_block (l, b, rand,
+            payloads + b * frame_size));
+  size = gst_buffer_get_size (src.file);
+  g_mutex_init (&src.lock);
+
+  pipeline = gst_pipeline_new (NULL);
+  appsrc = gst_element_factory_make ("appsrc", NULL);
+  demux = gst_element_factory_make ("rmdemux", NULL);
+  fail_unless (appsrc != NULL && demux != NULL);
+  gst_util_set_object_arg (G_OBJECT (appsrc), "stream-type", "random-access");
+  caps = gst_caps_new_empty_simple ("application/vnd.rn-realmedia");
+  g_object_set (appsrc, "size", (gint64) size, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  g_signal_connect (appsrc, "seek-data", G_CALLBACK (seek_data_cb), &src);
+  g_signal_connect (appsrc, "need-data", G_CALLBACK (need_data_cb), &src);
+  g_signal_connect (demux, "pad-added", G_CALLBACK (link_fakesink_cb), &src);
+  gst_bin_add_many (GST_BIN (pipeline), appsrc, demux, NULL);
+  fail_unless (gst_element_link (appsrc, demux));
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  /* a frame every 80 ms and an index entry at most every 500 ms makes an
+   * entry every 7th frame; the first seek must not read the whole file */
+  check_pull_seek (pipeline, &src, l, payloads, 5000, 56, size / 2);
+  /* already scanned */
+  check_pull_seek (pipeline, &src, l, payloads, 2000, 21, size / 2);
+  /* the scan continues where the first one stopped */
+  check_pull_seek (pipeline, &src, l, payloads, 7000, 84, size);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+
+  gst_buffer_replace (&src.first, NULL);
+  gst_buffer_unref (src.file);
+  g_mutex_clear (&src.lock);
+  g_rand_free (rand);
+  g_free (payloads);
+}
+
+GST_END_TEST;
+
+static Suite *
+rmdemux_suite (void)
+{
+  Suite *s = suite_create ("rmdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_descramble_layouts);
+  tcase_add_test (tc_chain, test_sipr_flavors);
+  tcase_add_test (tc_chain, test_buffers_recycled);
+  tcase_add_test (tc_chain, test_video_fragments);
+  tcase_add_test (tc_chain, test_pull_seek_without_index);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rmdemux);
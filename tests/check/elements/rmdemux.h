@@ -0,0 +1,374 @@
+/* GStreamer
+ *
+ * rmdemux.h: generated RealMedia streams for the rmdemux tests and benchmarks
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* The streams have a single cook, sipr or dnet stream filled with random
+ * data. Each interleaving block can be descrambled the straightforward way
+ * here, to check the demuxer output or to compare its speed against.
+ * RealVideo streams have one frame per block, split into a fragment per
+ * packet. */
+
+#ifndef __RMDEMUX_TEST_H__
+#define __RMDEMUX_TEST_H__
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/check/gstharness.h>
+#include <gst/base/gstbytewriter.h>
+
+#define HEADER_SIZE         10
+#define PACKET_HEADER_SIZE  12
+#define PACKET_DURATION_MS  20
+
+typedef struct
+{
+  const gchar *fourcc;
+  guint flavor;
+  guint height;
+  guint packet_size;
+  guint leaf_size;
+} StreamLayout;
+
+static const StreamLayout layouts[] = {
+  {"cook", 0, 16, 600, 100},
+  {"cook", 0, 14, 372, 186},
+  {"cook", 0, 3, 240, 60},
+  {"cook", 0, 1, 100, 100},
+  /* odd sizes leave the last byte alone */
+  {"dnet", 0, 4, 101, 0},
+};
+
+/* one for each flavor, the leaf size is implied by the flavor; the first two
+ * make blocks of an odd number of nibbles */
+static const StreamLayout sipr_layouts[] = {
+  {"sipr", 0, 14, 232, 29},
+  {"sipr", 1, 14, 190, 19},
+  {"sipr", 2, 14, 296, 37},
+  {"sipr", 3, 14, 480, 20},
+};
+
+/* the height is the number of fragments per frame here, the packet size
+ * the size of each fragment */
+static const StreamLayout video_layouts[] = {
+  {"RV40", 0, 4, 600, 0},
+  /* more fragments than a buffer can hold memories */
+  {"RV40", 0, 40, 100, 0},
+};
+
+static const gint sipr_swap_index[38][2] = {
+  {0, 63}, {1, 22}, {2, 44}, {3, 90},
+  {5, 81}, {7, 31}, {8, 86}, {9, 58},
+  {10, 36}, {12, 68}, {13, 39}, {14, 73},
+  {15, 53}, {16, 69}, {17, 57}, {19, 88},
+  {20, 34}, {21, 71}, {24, 46}, {25, 94},
+  {26, 54}, {28, 75}, {29, 50}, {32, 70},
+  {33, 92}, {35, 74}, {38, 85}, {40, 56},
+  {42, 87}, {43, 65}, {45, 59}, {48, 79},
+  {49, 93}, {51, 89}, {55, 95}, {61, 76},
+  {67, 83}, {77, 80}
+};
+
+static void
+begin_chunk (GstByteWriter * bw, const gchar * fourcc)
+{
+  gst_byte_writer_put_data_unchecked (bw, (const guint8 *) fourcc, 4);
+  /* size, filled in by end_chunk */
+  gst_byte_writer_put_uint32_be_unchecked (bw, 0);
+  gst_byte_writer_put_uint16_be_unchecked (bw, 0);
+}
+
+static void
+end_chunk (GstByteWriter * bw, guint start)
+{
+  guint end = gst_byte_writer_get_pos (bw);
+
+  gst_byte_writer_set_pos (bw, start + 4);
+  gst_byte_writer_put_uint32_be_unchecked (bw, end - start);
+  gst_byte_writer_set_pos (bw, end);
+}
+
+static void
+put_string8 (GstByteWriter * bw, const gchar * str)
+{
+  gst_byte_writer_put_uint8_unchecked (bw, strlen (str));
+  gst_byte_writer_put_data_unchecked (bw, (const guint8 *) str, strlen (str));
+}
+
+static gboolean
+is_video (const StreamLayout * l)
+{
+  return strncmp (l->fourcc, "RV", 2) == 0;
+}
+
+/* type specific data of a RealVideo stream, 320x240 at 25 fps */
+static void
+put_video_header (GstByteWriter * bw, const StreamLayout * l)
+{
+  guint8 vido[34] = { 0, };
+
+  GST_WRITE_UINT32_BE (vido, sizeof (vido));
+  memcpy (vido + 4, "VIDO", 4);
+  memcpy (vido + 8, l->fourcc, 4);
+  GST_WRITE_UINT16_BE (vido + 12, 320);
+  GST_WRITE_UINT16_BE (vido + 14, 240);
+  GST_WRITE_UINT16_BE (vido + 16, 12);
+  GST_WRITE_UINT16_BE (vido + 22, 25);
+  GST_WRITE_UINT32_BE (vido + 30, 0x40000000);
+  gst_byte_writer_put_data_unchecked (bw, vido, sizeof (vido));
+}
+
+static GstBuffer *
+create_header (const StreamLayout * l, guint num_packets)
+{
+  GstByteWriter bw;
+  guint8 ra[73] = { 0, };
+  guint start, data_offset, type_specific_len;
+
+  gst_byte_writer_init_with_size (&bw, 512, TRUE);
+
+  start = gst_byte_writer_get_pos (&bw);
+  begin_chunk (&bw, ".RMF");
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 0);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 4);
+  end_chunk (&bw, start);
+
+  /* data offset, right after the PROP and MDPR chunks */
+  type_specific_len = is_video (l) ? 34 : sizeof (ra);
+  data_offset = start + 18 + 50 + HEADER_SIZE + 30 + 13 + 21 + 4 +
+      type_specific_len;
+
+  start = gst_byte_writer_get_pos (&bw);
+  begin_chunk (&bw, "PROP");
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 0);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 0);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, l->packet_size);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, l->packet_size);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, num_packets);
+  gst_byte_writer_put_uint32_be_unchecked (&bw,
+      num_packets * PACKET_DURATION_MS);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 0);
+  /* no index */
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 0);
+  gst_byte_writer_put_uint32_be_unchecked (&bw, data_offset);
+  gst_byte_writer_put_uint16_be_unchecked (&bw, 1);
+  gst_byte_writer_put_uint16_be_unchecked (&bw, 0);
+  end_chunk (&bw, start);
+
+  start = gst_byte_writer_get_pos (&bw);
+  begin_chunk (&bw, "MDPR");
+  /* stream 0, bitrates, packet sizes, start time, preroll and duration */
+  gst_byte_writer_put_uint16_be_unchecked (&bw, 0);
+  gst_byte_writer_fill_unchecked (&bw, 0, 28);
+  if (is_video (l)) {
+    put_string8 (&bw, "Video Stream");
+    put_string8 (&bw, "video/x-pn-realvideo");
+    gst_byte_writer_put_uint32_be_unchecked (&bw, type_specific_len);
+    put_video_header (&bw, l);
+  } else {
+    put_string8 (&bw, "Audio Stream");
+    put_string8 (&bw, "audio/x-pn-realaudio");
+    gst_byte_writer_put_uint32_be_unchecked (&bw, type_specific_len);
+    /* version 4 audio header, without codec data */
+    memcpy (ra, ".ra\xfd", 4);
+    GST_WRITE_UINT16_BE (ra + 4, 4);
+    GST_WRITE_UINT16_BE (ra + 22, l->flavor);
+    GST_WRITE_UINT32_BE (ra + 24, l->packet_size);
+    GST_WRITE_UINT16_BE (ra + 40, l->height);
+    GST_WRITE_UINT16_BE (ra + 42, l->packet_size);
+    GST_WRITE_UINT16_BE (ra + 44, l->leaf_size);
+    GST_WRITE_UINT16_BE (ra + 48, 44100);
+    GST_WRITE_UINT16_BE (ra + 52, 16);
+    GST_WRITE_UINT16_BE (ra + 54, 2);
+    memcpy (ra + 62, l->fourcc, 4);
+    gst_byte_writer_put_data_unchecked (&bw, ra, sizeof (ra));
+  }
+  end_chunk (&bw, start);
+
+  g_assert_cmpuint (gst_byte_writer_get_pos (&bw), ==, data_offset);
+
+  start = gst_byte_writer_get_pos (&bw);
+  begin_chunk (&bw, "DATA");
+  gst_byte_writer_put_uint32_be_unchecked (&bw, num_packets);
+  /* no next data chunk */
+  gst_byte_writer_put_uint32_be_unchecked (&bw, 0);
+  end_chunk (&bw, start);
+
+  return gst_byte_writer_reset_and_get_buffer (&bw);
+}
+
+/* size of the header in front of each fragment of a video frame */
+#define FRAGMENT_HEADER_SIZE  7
+
+/* creates the packets of one interleaving block, the payloads are returned
+ * in @payloads */
+static GstBuffer *
+create_block (const StreamLayout * l, guint block, GRand * rand,
+    guint8 * payloads)
+{
+  GstByteWriter bw;
+  guint p, i, header_size, frame_size;
+
+  header_size = PACKET_HEADER_SIZE + (is_video (l) ? FRAGMENT_HEADER_SIZE : 0);
+  frame_size = l->height * l->packet_size;
+  g_assert (!is_video (l) || frame_size < 0x4000);
+  gst_byte_writer_init_with_size (&bw,
+      l->height * (header_size + l->packet_size), TRUE);
+
+  for (p = 0; p < l->height; ++p) {
+    guint8 *payload = payloads + p * l->packet_size;
+
+    for (i = 0; i < l->packet_size; ++i)
+      payload[i] = g_rand_int_range (rand, 0, 256);
+
+    gst_byte_writer_put_uint16_be_unchecked (&bw, 0);
+    gst_byte_writer_put_uint16_be_unchecked (&bw,
+        header_size + l->packet_size);
+    gst_byte_writer_put_uint16_be_unchecked (&bw, 0);
+    /* all fragments of a video frame have the frame's timestamp */
+    gst_byte_writer_put_uint32_be_unchecked (&bw, (block * l->height +
+            (is_video (l) ? 0 : p)) * PACKET_DURATION_MS);
+    gst_byte_writer_put_uint8_unchecked (&bw, 0);
+    /* the first packet of a block is a keyframe */
+    gst_byte_writer_put_uint8_unchecked (&bw, p == 0 ? 0x02 : 0x00);
+    if (is_video (l)) {
+      /* one of several fragments, with its number, the 14 bit frame size
+       * and offset, and the frame's sequence number */
+      gst_byte_writer_put_uint8_unchecked (&bw, 0x00);
+      gst_byte_writer_put_uint8_unchecked (&bw, p + 1);
+      gst_byte_writer_put_uint16_be_unchecked (&bw, 0x4000 | frame_size);
+      gst_byte_writer_put_uint16_be_unchecked (&bw,
+          0x4000 | (p * l->packet_size));
+      gst_byte_writer_put_uint8_unchecked (&bw, block & 0xff);
+    }
+    gst_byte_writer_put_data_unchecked (&bw, payload, l->packet_size);
+  }
+
+  return gst_byte_writer_reset_and_get_buffer (&bw);
+}
+
+static void
+interleave (const StreamLayout * l, const guint8 * in, guint8 * out)
+{
+  guint p, x;
+
+  for (p = 0; p < l->height; ++p) {
+    for (x = 0; x < l->packet_size / l->leaf_size; ++x) {
+      guint idx;
+
+      idx = l->height * x + ((l->height + 1) / 2) * (p % 2) + (p / 2);
+      memcpy (out + l->leaf_size * idx,
+          in + l->packet_size * p + l->leaf_size * x, l->leaf_size);
+    }
+  }
+}
+
+static guint
+get_nibble (const guint8 * data, guint idx)
+{
+  return (data[idx / 2] >> (4 * (idx % 2))) & 0x0f;
+}
+
+static void
+set_nibble (guint8 * data, guint idx, guint val)
+{
+  guint shift = 4 * (idx % 2);
+
+  data[idx / 2] = (data[idx / 2] & ~(0x0f << shift)) | (val << shift);
+}
+
+static void
+sipr_swap (const StreamLayout * l, const guint8 * in, guint8 * out)
+{
+  guint size = l->height * l->packet_size;
+  guint bs = size * 2 / 96;
+  guint n, i;
+
+  memcpy (out, in, size);
+  for (n = 0; n < 38; ++n) {
+    guint idx1 = bs * sipr_swap_index[n][0];
+    guint idx2 = bs * sipr_swap_index[n][1];
+
+    for (i = 0; i < bs; ++i) {
+      guint tmp = get_nibble (out, idx1 + i);
+
+      set_nibble (out, idx1 + i, get_nibble (out, idx2 + i));
+      set_nibble (out, idx2 + i, tmp);
+    }
+  }
+}
+
+static void
+byte_swap (const StreamLayout * l, const guint8 * in, guint8 * out)
+{
+  guint p, i;
+
+  memcpy (out, in, l->height * l->packet_size);
+  for (p = 0; p < l->height; ++p) {
+    guint8 *data = out + p * l->packet_size;
+
+    for (i = 0; i + 1 < l->packet_size; i += 2) {
+      data[i] = in[p * l->packet_size + i + 1];
+      data[i + 1] = in[p * l->packet_size + i];
+    }
+  }
+}
+
+/* descrambles a block the straightforward way, for checking the demuxer
+ * output, returns the number of buffers the demuxer makes out of it */
+static guint
+descramble (const StreamLayout * l, const guint8 * in, guint8 * out)
+{
+  if (strcmp (l->fourcc, "sipr") == 0) {
+    sipr_swap (l, in, out);
+    return 1;
+  } else if (strcmp (l->fourcc, "dnet") == 0) {
+    byte_swap (l, in, out);
+  } else {
+    interleave (l, in, out);
+  }
+  return l->height;
+}
+
+static void
+pad_added_cb (GstElement * demux, GstPad * pad, GstHarness * h)
+{
+  gst_harness_add_element_src_pad (h, pad);
+}
+
+static GstHarness *
+setup_rmdemux (const StreamLayout * l, guint num_blocks)
+{
+  GstHarness *h;
+  GstFlowReturn ret;
+
+  h = gst_harness_new_with_padnames ("rmdemux", "sink", NULL);
+  g_signal_connect (h->element, "pad-added", G_CALLBACK (pad_added_cb), h);
+
+  gst_harness_push_event (h, gst_event_new_stream_start ("rmdemux-test"));
+  gst_harness_push_event (h,
+      gst_event_new_caps (gst_caps_new_empty_simple
+          ("application/vnd.rn-realmedia")));
+
+  ret = gst_harness_push (h, create_header (l, num_blocks * l->height));
+  g_assert_cmpint (ret, ==, GST_FLOW_OK);
+
+  return h;
+}
+
+#endif /* __RMDEMUX_TEST_H__ */
@@ -0,0 +1,78 @@
+/* GStreamer
+ *
+ * asfdemux.c: libFuzzer target for the asf demuxer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Sets up the demuxer with the generated header from the unit test, like
+ * the packet tests and the benchmark do, and pushes the fuzzer input as
+ * data packets after it, so the mutations land in the packet and payload
+ * parsing instead of being rejected by the header parsing. The element is
+ * registered statically, so no plugin registry is needed. */
+
+#include <gst/riff/riff-read.h>
+
+#include "../check/elements/asfdemux.h"
+#include "gstasfdemux.h"
+
+static void
+drain (GstHarness * h)
+{
+  GstBuffer *buf;
+  GstEvent *event;
+
+  while ((buf = gst_harness_try_pull (h)))
+    gst_buffer_unref (buf);
+  while ((event = gst_harness_try_pull_event (h)))
+    gst_event_unref (event);
+}
+
+int
+LLVMFuzzerTestOneInput (const guint8 * data, size_t size)
+{
+  static gboolean initialized = FALSE;
+  GstHarness *h;
+  gsize offset, num_packets;
+
+  if (!initialized) {
+    gst_init (NULL, NULL);
+    GST_DEBUG_CATEGORY_INIT (asfdemux_dbg, "asfdemux", 0,
+        "asf demuxer element");
+    gst_riff_init ();
+    gst_element_register (NULL, "asfdemux", GST_RANK_PRIMARY,
+        GST_TYPE_ASF_DEMUX);
+    initialized = TRUE;
+  }
+
+  num_packets = (size + PACKET_SIZE - 1) / PACKET_SIZE;
+  h = setup_asfdemux (MAX (num_packets, 1));
+
+  for (offset = 0; offset < size; offset += PACKET_SIZE) {
+    gsize len = MIN (size - offset, PACKET_SIZE);
+
+    if (gst_harness_push (h, gst_buffer_new_wrapped (g_memdup (data + offset,
+                    len), len)) != GST_FLOW_OK)
+      break;
+    drain (h);
+  }
+
+  gst_harness_push_event (h, gst_event_new_eos ());
+  drain (h);
+  gst_harness_teardown (h);
+
+  return 0;
+}